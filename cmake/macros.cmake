@@ -15,6 +15,55 @@ return _BitScanReverse64(&foo, bar);}"
     )
 ENDMACRO()
 
+MACRO(CHECK_SSSE3 VARIABLE)
+  CHECK_C_SOURCE_COMPILES(
+    "#include <immintrin.h>
+__attribute__((target(\"ssse3\"))) static int foo(void)
+{__m128i x = _mm_shuffle_epi8(_mm_setzero_si128(), _mm_set1_epi8(1));
+return _mm_cvtsi128_si32(x);}
+int main(int argc, char *argv[])
+{return __builtin_cpu_supports(\"ssse3\") ? foo() : 0;}"
+    ${VARIABLE}
+    )
+ENDMACRO()
+
+MACRO(CHECK_SSE41 VARIABLE)
+  CHECK_C_SOURCE_COMPILES(
+    "#include <immintrin.h>
+__attribute__((target(\"sse4.1\"))) static int foo(void)
+{__m128i x = _mm_min_epu32(_mm_setzero_si128(), _mm_set1_epi32(1));
+return _mm_extract_epi32(_mm_blendv_epi8(x, x, x), 0);}
+int main(int argc, char *argv[])
+{return __builtin_cpu_supports(\"sse4.1\") ? foo() : 0;}"
+    ${VARIABLE}
+    )
+ENDMACRO()
+
+MACRO(CHECK_AVX2 VARIABLE)
+  CHECK_C_SOURCE_COMPILES(
+    "#include <immintrin.h>
+__attribute__((target(\"avx2\"))) static int foo(void)
+{__m256i x = _mm256_cvtepu32_epi64(_mm_setzero_si128());
+return _mm256_extract_epi32(_mm256_srl_epi64(x, _mm_cvtsi32_si128(1)), 0);}
+int main(int argc, char *argv[])
+{return __builtin_cpu_supports(\"avx2\") ? foo() : 0;}"
+    ${VARIABLE}
+    )
+ENDMACRO()
+
+MACRO(CHECK_AVX512F VARIABLE)
+  CHECK_C_SOURCE_COMPILES(
+    "#include <immintrin.h>
+__attribute__((target(\"avx512f\"))) static int foo(void)
+{__m512i x = _mm512_cvtepu32_epi64(_mm256_setzero_si256());
+return (int)_mm512_reduce_add_epi64(
+_mm512_srl_epi64(x, _mm_cvtsi32_si128(1)));}
+int main(int argc, char *argv[])
+{return __builtin_cpu_supports(\"avx512f\") ? foo() : 0;}"
+    ${VARIABLE}
+    )
+ENDMACRO()
+
 MACRO(FIND_INLINE_KEYWORD)
   #Inspired from http://www.cmake.org/Wiki/CMakeTestInline
   SET(INLINE_TEST_SRC "/* Inspired by autoconf's c.m4 */
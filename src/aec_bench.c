@@ -0,0 +1,641 @@
+/**
+ * @file aec_bench.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Benchmark harness for the Adaptive Entropy Coding library
+ *
+ */
+
+/* clock_gettime() */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libaec.h"
+#include "datagen.h"
+
+#define MAX_LIST 64
+
+/* Storage options, named as in the JSON output */
+struct flag_set {
+    const char *name;
+    unsigned int flags;
+};
+
+static const struct flag_set flag_sets[] = {
+    {"pp", AEC_DATA_PREPROCESS},
+    {"raw", 0},
+    {"signed", AEC_DATA_PREPROCESS | AEC_DATA_SIGNED},
+    {"msb", AEC_DATA_PREPROCESS | AEC_DATA_MSB},
+    {"3byte", AEC_DATA_PREPROCESS | AEC_DATA_3BYTE},
+    {"restricted", AEC_DATA_PREPROCESS | AEC_RESTRICTED},
+    {"pad", AEC_DATA_PREPROCESS | AEC_PAD_RSI},
+};
+#define NFLAG_SETS (sizeof(flag_sets) / sizeof(flag_sets[0]))
+
+/* Data sets, the sample models of datagen and blocks made for one or
+ * all code options */
+struct data_set {
+    const char *name;
+    enum datagen_model model;
+    int options;
+};
+
+static const struct data_set data_sets[] = {
+    {"smooth", DATAGEN_SMOOTH, 0},
+    {"noisy", DATAGEN_NOISY, 0},
+    {"zero", DATAGEN_ZERO, 0},
+    {"random", DATAGEN_RANDOM, 0},
+    {"zero-blocks", DATAGEN_OPTIONS, DATAGEN_ZERO_BLOCK},
+    {"se", DATAGEN_OPTIONS, DATAGEN_SE},
+    {"split", DATAGEN_OPTIONS, DATAGEN_SPLIT},
+    {"uncomp", DATAGEN_OPTIONS, DATAGEN_UNCOMP},
+    {"mixed", DATAGEN_OPTIONS, DATAGEN_ALL},
+    {"file", DATAGEN_OPTIONS, 0}
+};
+#define NDATA_SETS (sizeof(data_sets) / sizeof(data_sets[0]))
+#define DATA_FILE (NDATA_SETS - 1)
+
+struct bench {
+    unsigned int bps[MAX_LIST];
+    unsigned int block_size[MAX_LIST];
+    unsigned int rsi[MAX_LIST];
+    unsigned int flag_set[MAX_LIST];
+    unsigned int data[MAX_LIST];
+    int nbps, nblock_size, nrsi, nflag_set, ndata;
+
+    /* parameters of the option data sets */
+    int k_min;
+    int k_max;
+    unsigned int zero_run;
+
+    /* bytes of samples per run */
+    size_t size;
+    int warmup;
+    int repetitions;
+    int quiet;
+
+    /* contents of the input file for DATA_FILE, at least size bytes */
+    unsigned char *file;
+    size_t file_len;
+
+    unsigned char *ubuf;
+    unsigned char *cbuf;
+    unsigned char *obuf;
+    size_t cbuf_len;
+    double *times;
+
+    FILE *json;
+    int nresults;
+};
+
+struct timing {
+    double median;
+    double p99;
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void summarize(double *times, int n, struct timing *t)
+{
+    /**
+       Median and 99th percentile (nearest rank) of n run times.
+    */
+
+    int rank;
+
+    qsort(times, n, sizeof(double), compare_double);
+    if (n % 2)
+        t->median = times[n / 2];
+    else
+        t->median = (times[n / 2 - 1] + times[n / 2]) / 2;
+    rank = (99 * n + 99) / 100;
+    t->p99 = times[rank - 1];
+}
+
+static int time_codec(struct bench *b, struct aec_stream *strm,
+                      size_t len, int decode, size_t *total_out,
+                      struct timing *t)
+{
+    int i, status;
+    double t0;
+
+    for (i = -b->warmup; i < b->repetitions; i++) {
+        if (decode) {
+            strm->next_in = b->cbuf;
+            strm->avail_in = *total_out;
+            strm->next_out = b->obuf;
+            strm->avail_out = len;
+        } else {
+            strm->next_in = b->ubuf;
+            strm->avail_in = len;
+            strm->next_out = b->cbuf;
+            strm->avail_out = b->cbuf_len;
+        }
+        t0 = now();
+        if (decode)
+            status = aec_buffer_decode(strm);
+        else
+            status = aec_buffer_encode(strm);
+        if (i >= 0)
+            b->times[i] = now() - t0;
+        if (status != AEC_OK)
+            return status;
+    }
+    if (!decode)
+        *total_out = strm->total_out;
+    summarize(b->times, b->repetitions, t);
+    return AEC_OK;
+}
+
+static void print_timing(FILE *fp, const char *name, struct timing *t,
+                         size_t size)
+{
+    fprintf(fp, "\"%s\": {\"median_s\": %.9f, \"p99_s\": %.9f, "
+            "\"median_mib_s\": %.2f}", name, t->median, t->p99,
+            size / 1048576.0 / t->median);
+}
+
+static int count_options(struct bench *b, struct aec_stream *strm,
+                         size_t len, struct aec_stats *stats)
+{
+    /**
+       Encode once more, untimed, and collect code option statistics.
+    */
+
+    int status;
+
+    status = aec_encode_init(strm);
+    if (status != AEC_OK)
+        return status;
+    strm->next_in = b->ubuf;
+    strm->avail_in = len;
+    strm->next_out = b->cbuf;
+    strm->avail_out = b->cbuf_len;
+    if ((status = aec_encode_enable_stats(strm)) == AEC_OK
+        && (status = aec_encode(strm, AEC_FLUSH)) == AEC_OK)
+        status = aec_encode_get_stats(strm, stats);
+    aec_encode_end(strm);
+    return status;
+}
+
+static void print_sizes(FILE *fp, const char *name, const size_t *v,
+                        int n)
+{
+    int i;
+
+    fprintf(fp, "\"%s\": [", name);
+    for (i = 0; i < n; i++)
+        fprintf(fp, "%s%lu", i? ", ": "", (unsigned long)v[i]);
+    fprintf(fp, "]");
+}
+
+static void print_options(FILE *fp, const struct aec_stats *stats)
+{
+    /**
+       Blocks and bits per code option. Split arrays are indexed by k
+       and end at the largest k used, zero_runs is indexed by run
+       length and ends at the longest run.
+    */
+
+    int nk, nruns;
+
+    for (nk = AEC_STATS_KMAX; nk > 0; nk--)
+        if (stats->split_blocks[nk - 1])
+            break;
+    for (nruns = AEC_STATS_RUNS; nruns > 0; nruns--)
+        if (stats->zero_runs[nruns - 1])
+            break;
+
+    fprintf(fp, "\"options\": {\"zero_blocks\": %lu, \"zero_bits\": %lu, "
+            "\"se_blocks\": %lu, \"se_bits\": %lu, "
+            "\"uncomp_blocks\": %lu, \"uncomp_bits\": %lu,\n      ",
+            (unsigned long)stats->zero_blocks,
+            (unsigned long)stats->zero_bits,
+            (unsigned long)stats->se_blocks, (unsigned long)stats->se_bits,
+            (unsigned long)stats->uncomp_blocks,
+            (unsigned long)stats->uncomp_bits);
+    print_sizes(fp, "split_blocks", stats->split_blocks, nk);
+    fprintf(fp, ", ");
+    print_sizes(fp, "split_bits", stats->split_bits, nk);
+    fprintf(fp, ",\n      ");
+    print_sizes(fp, "zero_runs", stats->zero_runs, nruns);
+    fprintf(fp, "}");
+}
+
+static int run_case(struct bench *b, unsigned int bps,
+                    unsigned int block_size, unsigned int rsi,
+                    const struct flag_set *fs, unsigned int data)
+{
+    int status;
+    size_t len, total_out;
+    struct aec_stream strm;
+    struct timing enc, dec;
+    struct aec_stats stats;
+    struct datagen gen;
+
+    datagen_init(&gen, bps, block_size, rsi, fs->flags);
+    gen.model = data_sets[data].model;
+    gen.options = data_sets[data].options;
+    gen.k_min = b->k_min;
+    gen.k_max = b->k_max;
+    gen.zero_run = b->zero_run;
+    if (data == DATA_FILE) {
+        len = b->size - b->size % datagen_sample_size(&gen);
+        memcpy(b->ubuf, b->file, len);
+    } else {
+        len = datagen_fill(&gen, b->ubuf, b->size);
+    }
+    if (len == 0)
+        return 0;
+
+    strm.bits_per_sample = bps;
+    strm.block_size = block_size;
+    strm.rsi = rsi;
+    strm.flags = fs->flags;
+
+    status = time_codec(b, &strm, len, 0, &total_out, &enc);
+    if (status == AEC_CONF_ERROR)
+        return 0;
+    if (status != AEC_OK) {
+        fprintf(stderr, "Encoding failed (%i).\n", status);
+        return 1;
+    }
+    status = time_codec(b, &strm, len, 1, &total_out, &dec);
+    if (status != AEC_OK) {
+        fprintf(stderr, "Decoding failed (%i).\n", status);
+        return 1;
+    }
+    if (strm.total_out != len || memcmp(b->ubuf, b->obuf, len)) {
+        fprintf(stderr, "Decoded data differs for %u bit, block size %u, "
+                "rsi %u, %s, %s.\n", bps, block_size, rsi, fs->name,
+                data_sets[data].name);
+        return 1;
+    }
+    status = count_options(b, &strm, len, &stats);
+    if (status != AEC_OK) {
+        fprintf(stderr, "Encoding failed (%i).\n", status);
+        return 1;
+    }
+
+    if (!b->quiet)
+        fprintf(stderr, "%2u bit %2u %5u %-10s %-11s ratio %7.3f "
+                "enc %8.2f dec %8.2f MiB/s\n", bps, block_size, rsi,
+                fs->name, data_sets[data].name, (double)len / total_out,
+                len / 1048576.0 / enc.median,
+                len / 1048576.0 / dec.median);
+
+    fprintf(b->json, "%s\n    {\"bits_per_sample\": %u, "
+            "\"block_size\": %u, \"rsi\": %u, \"flags\": \"%s\", "
+            "\"data\": \"%s\", \"bytes\": %lu, \"compressed\": %lu, "
+            "\"ratio\": %.4f,\n     ", b->nresults? ",": "", bps,
+            block_size, rsi, fs->name, data_sets[data].name,
+            (unsigned long)len, (unsigned long)total_out,
+            (double)len / total_out);
+    print_timing(b->json, "encode", &enc, len);
+    fprintf(b->json, ",\n     ");
+    print_timing(b->json, "decode", &dec, len);
+    fprintf(b->json, ",\n     ");
+    print_options(b->json, &stats);
+    fprintf(b->json, "}");
+    b->nresults++;
+    return 0;
+}
+
+static int parse_list(unsigned int *list, int *n, const char *arg)
+{
+    /**
+       Parse comma separated numbers and ranges like "8,12-16".
+    */
+
+    char *end;
+    unsigned long a, z;
+
+    *n = 0;
+    for (;;) {
+        a = strtoul(arg, &end, 10);
+        if (end == arg)
+            return 1;
+        z = a;
+        if (*end == '-') {
+            arg = end + 1;
+            z = strtoul(arg, &end, 10);
+            if (end == arg || z < a)
+                return 1;
+        }
+        for (; a <= z; a++) {
+            if (*n == MAX_LIST)
+                return 1;
+            list[(*n)++] = a;
+        }
+        if (*end == '\0')
+            return 0;
+        if (*end != ',')
+            return 1;
+        arg = end + 1;
+    }
+}
+
+static int parse_names(unsigned int *list, int *n, const char *arg,
+                       const char *(*name)(unsigned int), unsigned int count)
+{
+    /**
+       Parse comma separated names returned by name().
+    */
+
+    unsigned int i;
+    size_t len;
+
+    *n = 0;
+    for (;;) {
+        len = strcspn(arg, ",");
+        for (i = 0; i < count; i++)
+            if (strlen(name(i)) == len && strncmp(arg, name(i), len) == 0)
+                break;
+        if (i == count || *n == MAX_LIST)
+            return 1;
+        list[(*n)++] = i;
+        if (arg[len] == '\0')
+            return 0;
+        arg += len + 1;
+    }
+}
+
+static const char *flag_set_name(unsigned int i)
+{
+    return flag_sets[i].name;
+}
+
+static const char *data_set_name(unsigned int i)
+{
+    return data_sets[i].name;
+}
+
+static int read_file(struct bench *b, const char *fn)
+{
+    FILE *fp;
+    long len;
+
+    fp = fopen(fn, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: cannot open %s\n", fn);
+        return 1;
+    }
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    rewind(fp);
+    if (len <= 0 || (b->file = malloc(len)) == NULL
+        || fread(b->file, 1, len, fp) != (size_t)len) {
+        fprintf(stderr, "ERROR: cannot read %s\n", fn);
+        fclose(fp);
+        return 1;
+    }
+    b->file_len = len;
+    fclose(fp);
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "NAME\n\taec_bench - benchmark libaec\n\n");
+    fprintf(stderr, "SYNOPSIS\n\taec_bench [OPTION]...\n");
+    fprintf(stderr, "\nOPTIONS\n");
+    fprintf(stderr, "\t-b list\n\t\tbits per sample, default 1-32\n");
+    fprintf(stderr, "\t-j list\n\t\tblock sizes, default 8,16,32,64\n");
+    fprintf(stderr, "\t-r list\n\t\treference sample intervals, "
+            "default 64,4096\n");
+    fprintf(stderr, "\t-f list\n\t\tflags out of pp, raw, signed, msb, "
+            "3byte, restricted, pad,\n\t\tdefault pp,raw,signed\n");
+    fprintf(stderr, "\t-d list\n\t\tdata out of smooth, noisy, zero, "
+            "random and blocks made\n\t\tfor the code options "
+            "zero-blocks, se, split, uncomp or all of\n\t\tthem, mixed. "
+            "Default all\n");
+    fprintf(stderr, "\t-k min[-max]\n\t\tsplitting positions of split "
+            "blocks, default 1-8\n");
+    fprintf(stderr, "\t-z count\n\t\tzero blocks in a run, default 4\n");
+    fprintf(stderr, "\t-i file\n\t\tuse samples from file instead of "
+            "synthetic data\n");
+    fprintf(stderr, "\t-s size\n\t\tKiB of samples per run, default "
+            "1024\n");
+    fprintf(stderr, "\t-n count\n\t\ttimed repetitions, default 11\n");
+    fprintf(stderr, "\t-w count\n\t\tuntimed warm-up runs, default 2\n");
+    fprintf(stderr, "\t-o file\n\t\twrite JSON to file instead of "
+            "stdout\n");
+    fprintf(stderr, "\t-q\n\t\tno progress on stderr\n");
+    fprintf(stderr, "\nLists are comma separated, numbers may be given "
+            "as ranges like 8-16.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    struct bench b;
+    int iarg, ib, ij, ir, iff, id, status;
+    char *opt, *arg, *outfn;
+
+    memset(&b, 0, sizeof(b));
+    parse_list(b.bps, &b.nbps, "1-32");
+    parse_list(b.block_size, &b.nblock_size, "8,16,32,64");
+    parse_list(b.rsi, &b.nrsi, "64,4096");
+    parse_names(b.flag_set, &b.nflag_set, "pp,raw,signed",
+                flag_set_name, NFLAG_SETS);
+    parse_names(b.data, &b.ndata, "smooth,noisy,zero,random,zero-blocks,"
+                "se,split,uncomp,mixed", data_set_name, NDATA_SETS - 1);
+    b.k_min = 1;
+    b.k_max = 8;
+    b.zero_run = 4;
+    b.size = 1024;
+    b.repetitions = 11;
+    b.warmup = 2;
+    outfn = NULL;
+    status = 0;
+
+    for (iarg = 1; iarg < argc; iarg++) {
+        opt = argv[iarg];
+        if (opt[0] != '-' || opt[1] == '\0')
+            goto FAIL;
+        if (opt[1] == 'q') {
+            b.quiet = 1;
+            continue;
+        }
+        if (opt[2])
+            arg = opt + 2;
+        else if (++iarg < argc)
+            arg = argv[iarg];
+        else
+            goto FAIL;
+
+        switch (opt[1]) {
+        case 'b':
+            status = parse_list(b.bps, &b.nbps, arg);
+            break;
+        case 'j':
+            status = parse_list(b.block_size, &b.nblock_size, arg);
+            break;
+        case 'r':
+            status = parse_list(b.rsi, &b.nrsi, arg);
+            break;
+        case 'f':
+            status = parse_names(b.flag_set, &b.nflag_set, arg,
+                                 flag_set_name, NFLAG_SETS);
+            break;
+        case 'd':
+            status = parse_names(b.data, &b.ndata, arg,
+                                 data_set_name, NDATA_SETS - 1);
+            break;
+        case 'k':
+            if (sscanf(arg, "%i-%i", &b.k_min, &b.k_max) == 1)
+                b.k_max = b.k_min;
+            status = b.k_min < 0 || b.k_max < b.k_min;
+            break;
+        case 'z':
+            b.zero_run = strtoul(arg, NULL, 10);
+            status = b.zero_run == 0;
+            break;
+        case 'i':
+            if (read_file(&b, arg))
+                return 1;
+            b.data[0] = DATA_FILE;
+            b.ndata = 1;
+            break;
+        case 's':
+            b.size = strtoul(arg, NULL, 10);
+            break;
+        case 'n':
+            b.repetitions = atoi(arg);
+            break;
+        case 'w':
+            b.warmup = atoi(arg);
+            break;
+        case 'o':
+            outfn = arg;
+            break;
+        default:
+            goto FAIL;
+        }
+        if (status)
+            goto FAIL;
+    }
+    if (b.size == 0 || b.repetitions < 1 || b.warmup < 0)
+        goto FAIL;
+
+    b.size *= 1024;
+    if (b.file && b.file_len < b.size)
+        b.size = b.file_len;
+    /* The encoder may expand random data slightly */
+    b.cbuf_len = b.size + b.size / 4 + 1024;
+    b.ubuf = malloc(b.size);
+    b.cbuf = malloc(b.cbuf_len);
+    b.obuf = malloc(b.size);
+    b.times = malloc(b.repetitions * sizeof(double));
+    if (!b.ubuf || !b.cbuf || !b.obuf || !b.times) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        return 1;
+    }
+
+    if (outfn) {
+        b.json = fopen(outfn, "w");
+        if (b.json == NULL) {
+            fprintf(stderr, "ERROR: cannot create %s\n", outfn);
+            return 1;
+        }
+    } else {
+        b.json = stdout;
+    }
+
+    fprintf(b.json, "{\"benchmark\": \"libaec\", \"size\": %lu, "
+            "\"warmup\": %i, \"repetitions\": %i, \"k_min\": %i, "
+            "\"k_max\": %i, \"zero_run\": %u,\n \"results\": [",
+            (unsigned long)b.size, b.warmup, b.repetitions, b.k_min,
+            b.k_max, b.zero_run);
+
+    for (ib = 0; ib < b.nbps && status == 0; ib++) {
+        for (ij = 0; ij < b.nblock_size && status == 0; ij++) {
+            for (ir = 0; ir < b.nrsi && status == 0; ir++) {
+                for (iff = 0; iff < b.nflag_set && status == 0; iff++) {
+                    const struct flag_set *fs = &flag_sets[b.flag_set[iff]];
+
+                    /* 3 byte storage only exists for 17 to 24 bits */
+                    if (fs->flags & AEC_DATA_3BYTE
+                        && (b.bps[ib] < 17 || b.bps[ib] > 24))
+                        continue;
+                    for (id = 0; id < b.ndata && status == 0; id++)
+                        status = run_case(&b, b.bps[ib], b.block_size[ij],
+                                          b.rsi[ir], fs, b.data[id]);
+                }
+            }
+        }
+    }
+
+    fprintf(b.json, "\n ]}\n");
+    if (outfn)
+        fclose(b.json);
+
+    free(b.ubuf);
+    free(b.cbuf);
+    free(b.obuf);
+    free(b.times);
+    free(b.file);
+    return status;
+
+FAIL:
+    usage();
+    return 1;
+}
@@ -1,7 +1,5 @@
 /**
- * @file utime.c
- *
- * @author Thomas Jahns, Deutsches Klimarechenzentrum
+ * @file alloc.c
  *
  * @section LICENSE
  * Copyright 2012 - 2016
@@ -45,79 +43,44 @@
  *
  * @section DESCRIPTION
  *
- * Simple timing command, since calling time(1) gives non-portable results.
+ * Memory management with optional user supplied functions
  *
  */
-#ifdef HAVE_CONFIG_H
-#include "config.h"
-#endif
 
-#include <errno.h>
-#include <stdio.h>
+#include <config.h>
 #include <stdlib.h>
-#include <sys/time.h>
-#include <sys/types.h>
-#include <sys/resource.h>
-#include <sys/wait.h>
-#include <unistd.h>
 
-static int
-run_cmd(int argc, char *argv[]);
+#include "alloc.h"
+#include "libaec.h"
 
-int main(int argc, char **argv)
+void aec_allocator_init(struct aec_allocator *alloc,
+                        const struct aec_stream *strm)
 {
-  struct timeval utime = { .tv_sec = 0, .tv_usec = 0 };
-  int status, rstatus;
-  if (argc > 1 && ((status = run_cmd(argc - 1, argv + 1)) >= 0))
-  {
-    struct rusage usage;
-    if ((rstatus = getrusage(RUSAGE_CHILDREN, &usage) == -1))
-    {
-      perror("resource usage statistics unavailable");
-    }
-    else if (rstatus != 0)
-    {
-      fputs("an unknown error occurred\n", stderr);
-      return EXIT_FAILURE;
-    }
-    else
-    {
-      utime = usage.ru_utime;
+    alloc->custom = (strm->flags & AEC_CUSTOM_ALLOC) != 0;
+    if (alloc->custom) {
+        alloc->zalloc = strm->zalloc;
+        alloc->zfree = strm->zfree;
+        alloc->opaque = strm->opaque;
+    } else {
+        alloc->zalloc = NULL;
+        alloc->zfree = NULL;
+        alloc->opaque = NULL;
     }
-  }
-  else if (status)
-  {
-    fputs("could not fork child\n", stderr);
-    return EXIT_FAILURE;
-  }
-  fprintf(stderr, "%f\n", (utime.tv_sec * 1000000 + utime.tv_usec)/1000000.0);
-  return status;
 }
 
-static int
-run_cmd(int argc, char *argv[])
+void *aec_alloc(const struct aec_allocator *alloc, size_t size)
 {
-  int status;
-  pid_t child_pid;
-  if (argc < 1)
-    return -1;
-  if ((child_pid = fork()) < 0)
-    status = -1;
-  else if (child_pid == 0)
-  {
-    /* child */
-    execvp(argv[0], argv);
-    _exit(127); /* execvp should not have returned */
-  }
-  else
-  {
-    while (waitpid(child_pid, &status, 0) < 0)
-      if (errno != EINTR)
-      {
-        status = -1;
-        break;
-      }
-  }
-  return status;
+    if (alloc->custom)
+        return alloc->zalloc(alloc->opaque, 1, size);
+    return malloc(size);
 }
 
+void aec_free(const struct aec_allocator *alloc, void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    if (alloc->custom)
+        alloc->zfree(alloc->opaque, ptr);
+    else
+        free(ptr);
+}
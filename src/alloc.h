@@ -0,0 +1,78 @@
+/**
+ * @file alloc.h
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Memory management with optional user supplied functions
+ *
+ */
+
+#ifndef ALLOC_H
+#define ALLOC_H 1
+
+#include <config.h>
+#include <stddef.h>
+
+struct aec_stream;
+
+/* Allocation functions of a stream as they were when it was set
+ * up. Memory is released with the same functions even if the user
+ * changes flags, zalloc, zfree or opaque of the stream later. */
+struct aec_allocator {
+    int custom;
+    void *(*zalloc)(void *opaque, size_t items, size_t size);
+    void (*zfree)(void *opaque, void *address);
+    void *opaque;
+};
+
+/* Take zalloc, zfree and opaque from strm if AEC_CUSTOM_ALLOC is
+ * set, use malloc and free otherwise. */
+void aec_allocator_init(struct aec_allocator *alloc,
+                        const struct aec_stream *strm);
+
+void *aec_alloc(const struct aec_allocator *alloc, size_t size);
+
+/* Release memory obtained by aec_alloc(). ptr may be NULL. */
+void aec_free(const struct aec_allocator *alloc, void *ptr);
+
+#endif /* ALLOC_H */
@@ -0,0 +1,302 @@
+/**
+ * @file datagen.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Synthetic test data for benchmarks and tests
+ *
+ */
+
+#include "datagen.h"
+#include "libaec.h"
+
+#define MIN(a, b) (((a) < (b))? (a): (b))
+
+static const char *model_names[] = {
+    "smooth", "noisy", "zero", "random", "options"
+};
+
+static uint64_t rng_next(uint64_t *s)
+{
+    /**
+       xorshift64*, the same sequence on every platform.
+    */
+
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return *s * UINT64_C(2685821657736338717);
+}
+
+static long long uniform(uint64_t *s, long long lo, long long hi)
+{
+    return lo + (long long)(rng_next(s) % (uint64_t)(hi - lo + 1));
+}
+
+static long long clamp(long long x, long long lo, long long hi)
+{
+    return x < lo? lo: x > hi? hi: x;
+}
+
+static void put_sample(unsigned char *dest, long long x, int size, int msb)
+{
+    int i;
+    unsigned long long u = (unsigned long long)x;
+
+    for (i = 0; i < size; i++)
+        dest[msb? size - 1 - i: i] = (unsigned char)(u >> (8 * i));
+}
+
+static long long unmap(long long a, long long d, long long xmin,
+                       long long xmax)
+{
+    /**
+       Inverse of the preprocessor: the sample following a which is
+       mapped to d.
+    */
+
+    long long theta = MIN(a - xmin, xmax - a);
+
+    if (d <= 2 * theta)
+        return d & 1? a - (d + 1) / 2: a + d / 2;
+    if (theta == a - xmin)
+        return xmin + d;
+    return xmax - d;
+}
+
+static int kmax(const struct datagen *gen)
+{
+    /**
+       Largest splitting position the encoder can use which is still
+       cheaper than uncompressed blocks.
+    */
+
+    int id_len, k;
+
+    if (gen->bits_per_sample > 16)
+        id_len = 5;
+    else if (gen->bits_per_sample > 8)
+        id_len = 4;
+    else if (gen->flags & AEC_RESTRICTED && gen->bits_per_sample <= 4)
+        id_len = gen->bits_per_sample <= 2? 1: 2;
+    else
+        id_len = 3;
+
+    k = (1 << id_len) - 3;
+    return MIN(k, (int)gen->bits_per_sample - 2);
+}
+
+void datagen_init(struct datagen *gen, unsigned int bits_per_sample,
+                  unsigned int block_size, unsigned int rsi,
+                  unsigned int flags)
+{
+    gen->bits_per_sample = bits_per_sample;
+    gen->block_size = block_size;
+    gen->rsi = rsi;
+    gen->flags = flags;
+    gen->model = DATAGEN_SMOOTH;
+    gen->options = DATAGEN_ALL;
+    gen->zero_run = 4;
+    gen->k_min = 1;
+    gen->k_max = 8;
+    gen->seed = UINT64_C(0x9e3779b97f4a7c15) ^ bits_per_sample;
+}
+
+int datagen_sample_size(const struct datagen *gen)
+{
+    if (gen->bits_per_sample > 16) {
+        if (gen->bits_per_sample <= 24 && gen->flags & AEC_DATA_3BYTE)
+            return 3;
+        return 4;
+    }
+    if (gen->bits_per_sample > 8)
+        return 2;
+    return 1;
+}
+
+const char *datagen_model_name(enum datagen_model model)
+{
+    if ((unsigned int)model >= sizeof(model_names) / sizeof(model_names[0]))
+        return NULL;
+    return model_names[model];
+}
+
+static int draw_option(struct datagen *gen)
+{
+    int i, n, options[4];
+
+    n = 0;
+    for (i = 0; i < 4; i++)
+        if (gen->options & (1 << i))
+            options[n++] = 1 << i;
+    if (n == 0)
+        return DATAGEN_SPLIT;
+    return options[uniform(&gen->seed, 0, n - 1)];
+}
+
+static void fill_options(struct datagen *gen, unsigned char *dest,
+                         size_t n, long long xmin, long long xmax)
+{
+    /**
+       Make blocks of preprocessed values d for the drawn code options
+       and turn them into samples. Without preprocessing the samples
+       are the values themselves, also for signed data.
+    */
+
+    size_t i, j, bs, se_pos;
+    int size = datagen_sample_size(gen);
+    int msb = (gen->flags & AEC_DATA_MSB) != 0;
+    int pp = (gen->flags & AEC_DATA_PREPROCESS) != 0;
+    int option = 0, k, k_lo, k_hi;
+    unsigned int zero_left = 0;
+    size_t rsi_len = (size_t)gen->rsi * gen->block_size;
+    long long x, d, range = xmax - xmin;
+
+    k_hi = MIN(gen->k_max, kmax(gen));
+    k_lo = MIN(gen->k_min, k_hi);
+    if (k_lo < 0)
+        k_lo = 0;
+    if (k_hi < k_lo)
+        k_hi = k_lo;
+    x = xmin + range / 2;
+
+    for (i = 0; i < n; i += bs) {
+        bs = MIN(gen->block_size, n - i);
+        if (zero_left) {
+            zero_left--;
+            option = DATAGEN_ZERO_BLOCK;
+        } else {
+            option = draw_option(gen);
+            if (option == DATAGEN_ZERO_BLOCK && gen->zero_run > 1)
+                zero_left = gen->zero_run - 1;
+        }
+        k = (int)uniform(&gen->seed, k_lo, k_hi);
+        se_pos = (size_t)uniform(&gen->seed, 0, bs - 1);
+
+        for (j = 0; j < bs; j++) {
+            switch (option) {
+            case DATAGEN_ZERO_BLOCK:
+                d = 0;
+                break;
+            case DATAGEN_SE:
+                d = j == se_pos;
+                break;
+            case DATAGEN_SPLIT:
+                d = uniform(&gen->seed, 0, (2LL << k) - 1);
+                break;
+            default:
+                d = uniform(&gen->seed, 0, range);
+                break;
+            }
+            d = MIN(d, range);
+
+            if (!pp)
+                x = d;
+            else if ((i + j) % rsi_len)
+                x = unmap(x, d, xmin, xmax);
+            /* else: reference sample, keep x */
+
+            put_sample(dest + (i + j) * size, x, size, msb);
+        }
+    }
+}
+
+size_t datagen_fill(struct datagen *gen, unsigned char *dest, size_t len)
+{
+    size_t i, n;
+    int size = datagen_sample_size(gen);
+    int msb = (gen->flags & AEC_DATA_MSB) != 0;
+    unsigned int bps = gen->bits_per_sample;
+    long long lo, hi, x, v, step, noise;
+    int burst = 0;
+
+    if (gen->flags & AEC_DATA_SIGNED) {
+        lo = -(1LL << (bps - 1));
+        hi = (1LL << (bps - 1)) - 1;
+    } else {
+        lo = 0;
+        hi = (1LL << bps) - 1;
+    }
+    n = len / size;
+
+    if (gen->model == DATAGEN_OPTIONS) {
+        fill_options(gen, dest, n, lo, hi);
+        return n * size;
+    }
+
+    step = (hi - lo) >> 12;
+    if (step == 0)
+        step = 1;
+    noise = (hi - lo) >> 4;
+    if (noise == 0)
+        noise = 1;
+    x = lo + (hi - lo) / 2;
+
+    for (i = 0; i < n; i++) {
+        switch (gen->model) {
+        case DATAGEN_SMOOTH:
+            x = clamp(x + uniform(&gen->seed, -step, step), lo, hi);
+            v = x;
+            break;
+        case DATAGEN_NOISY:
+            x = clamp(x + uniform(&gen->seed, -step, step), lo, hi);
+            v = clamp(x + uniform(&gen->seed, -noise, noise), lo, hi);
+            break;
+        case DATAGEN_ZERO:
+            if (burst == 0 && rng_next(&gen->seed) % 4096 == 0)
+                burst = 64;
+            if (burst) {
+                burst--;
+                v = clamp(uniform(&gen->seed, -step, step), lo, hi);
+            } else {
+                v = 0;
+            }
+            break;
+        default:
+            v = uniform(&gen->seed, lo, hi);
+            break;
+        }
+        put_sample(dest + i * size, v, size, msb);
+    }
+    return n * size;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file datagen.h
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Synthetic test data for benchmarks and tests
+ *
+ */
+
+#ifndef DATAGEN_H
+#define DATAGEN_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Sample models. The first four describe the samples themselves,
+ * DATAGEN_OPTIONS builds blocks for the code options selected in
+ * datagen.options. */
+enum datagen_model {
+    DATAGEN_SMOOTH,  /* random walk with steps of 1/4096 of the range */
+    DATAGEN_NOISY,   /* the random walk plus noise of 1/16 of the range */
+    DATAGEN_ZERO,    /* zeros with rare short bursts */
+    DATAGEN_RANDOM,  /* uniform over the whole range */
+    DATAGEN_OPTIONS
+};
+
+/* Code options for DATAGEN_OPTIONS */
+#define DATAGEN_ZERO_BLOCK 1
+#define DATAGEN_SE 2
+#define DATAGEN_SPLIT 4
+#define DATAGEN_UNCOMP 8
+#define DATAGEN_ALL 15
+
+struct datagen {
+    /* parameters of the stream the data is made for */
+    unsigned int bits_per_sample;
+    unsigned int block_size;
+    unsigned int rsi;
+    unsigned int flags;
+
+    enum datagen_model model;
+
+    /* DATAGEN_OPTIONS: every block, or run of zero blocks, is made
+     * for an option drawn uniformly from this set */
+    int options;
+
+    /* number of zero blocks in a run */
+    unsigned int zero_run;
+
+    /* split blocks have a splitting position drawn uniformly from
+     * k_min to k_max, which gives about k + 1.5 bits per sample.
+     * The range is clipped to what the encoder can use. */
+    int k_min;
+    int k_max;
+
+    /* state of the random number generator */
+    uint64_t seed;
+};
+
+/* Set up gen for the given stream parameters with the smooth model,
+ * all code options, zero runs of 4 blocks and k from 1 to 8 */
+void datagen_init(struct datagen *gen, unsigned int bits_per_sample,
+                  unsigned int block_size, unsigned int rsi,
+                  unsigned int flags);
+
+/* Storage size of a sample in bytes */
+int datagen_sample_size(const struct datagen *gen);
+
+/* Fill dest with as many samples as fit into len bytes. Blocks and
+ * RSIs are counted from the start of dest. Returns the number of
+ * bytes written. */
+size_t datagen_fill(struct datagen *gen, unsigned char *dest, size_t len);
+
+/* Name of a model or NULL */
+const char *datagen_model_name(enum datagen_model model);
+
+#endif /* DATAGEN_H */
@@ -52,8 +52,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "alloc.h"
 #include "decode.h"
+#include "decode_simd.h"
 #include "libaec.h"
+#include "stats.h"
+#include "threads.h"
+#include "vector.h"
 
 #if HAVE_BSR64
 #  include <intrin.h>
@@ -67,11 +72,12 @@
 #define FLUSH(KIND)                                                      \
     static void flush_##KIND(struct aec_stream *strm)                    \
     {                                                                    \
-        uint32_t *flush_end, *bp, half_d;                                \
-        int32_t data, m;                                                 \
+        uint32_t *flush_end, *bp, half_d, m;                             \
+        int32_t data;                                                    \
         struct internal_state *state = strm->state;                      \
                                                                          \
-        flush_end = state->rsip;                                         \
+        flush_end = MIN(state->rsip,                                     \
+                        state->rsi_buffer + state->line_len);            \
         if (state->pp) {                                                 \
             if (state->flush_start == state->rsi_buffer                  \
                 && state->rsip > state->rsi_buffer) {                    \
@@ -80,7 +86,8 @@
                 if (strm->flags & AEC_DATA_SIGNED) {                     \
                     m = UINT32_C(1) << (strm->bits_per_sample - 1);      \
                     /* Reference samples have to be sign extended */     \
-                    state->last_out = (state->last_out ^ m) - m;         \
+                    state->last_out =                                    \
+                        (int32_t)(((uint32_t)state->last_out ^ m) - m);  \
                 }                                                        \
                 put_##KIND(strm, (uint32_t)state->last_out);             \
                 state->flush_start++;                                    \
@@ -96,38 +103,36 @@
                 for (bp = state->flush_start; bp < flush_end; bp++) {    \
                     d = *bp;                                             \
                     half_d = (d >> 1) + (d & 1);                         \
-                    /*in this case: data >= med == data & med */         \
-                    uint32_t mask = (data & med)?xmax:0;                 \
                                                                          \
-                    /*in this case: xmax - data == xmax ^ data */        \
-                    if (half_d <= (mask ^ (uint32_t)data)) {             \
+                    /* Test both limits in one branch since data */      \
+                    /* near med defeats branch prediction. */            \
+                    if (half_d <= MIN((uint32_t)data,                    \
+                                      xmax - (uint32_t)data)) {          \
                         data += (d >> 1)^(~((d & 1) - 1));               \
                     } else {                                             \
-                        data = mask ^ d;                                 \
+                        /*in this case: data >= med == data & med */     \
+                        data = ((data & med)? xmax: 0) ^ d;              \
                     }                                                    \
                     put_##KIND(strm, (uint32_t)data);                    \
                 }                                                        \
                 state->last_out = data;                                  \
             } else {                                                     \
-                int32_t xmax, d;                                         \
+                int32_t xmax, d, s;                                      \
                 xmax = state->xmax;                                      \
                                                                          \
                 for (bp = state->flush_start; bp < flush_end; bp++) {    \
                     d = *bp;                                             \
                     half_d = ((uint32_t)d >> 1) + (d & 1);               \
+                    /* s is -1 for negative data, 0 otherwise */         \
+                    s = data >> 31;                                      \
                                                                          \
-                    if (data < 0) {                                      \
-                        if (half_d <= xmax + (uint32_t)data + 1) {       \
-                            data += ((uint32_t)d >> 1)^(~((d & 1) - 1)); \
-                        } else {                                         \
-                            data = d - xmax - 1;                         \
-                        }                                                \
+                    /* xmax + data + 1 or xmax - data */                 \
+                    if (half_d <= xmax - (uint32_t)(data ^ s)) {         \
+                        data += ((uint32_t)d >> 1)^(~((d & 1) - 1));     \
                     } else {                                             \
-                        if (half_d <= xmax - (uint32_t)data) {           \
-                            data += ((uint32_t)d >> 1)^(~((d & 1) - 1)); \
-                        } else {                                         \
-                            data = xmax - d;                             \
-                        }                                                \
+                        /* d - xmax - 1 or xmax - d */                   \
+                        data = (int32_t)((uint32_t)xmax - (uint32_t)d)   \
+                            ^ s;                                         \
                     }                                                    \
                     put_##KIND(strm, (uint32_t)data);                    \
                 }                                                        \
@@ -196,6 +201,75 @@ FLUSH(lsb_24)
 FLUSH(lsb_16)
 FLUSH(8)
 
+static inline void put_buf(struct aec_stream *strm, uint32_t data)
+{
+    *strm->state->flush_wp++ = data;
+}
+
+FLUSH(buf)
+
+static void flush_vector(struct aec_stream *strm)
+{
+    /**
+       Postprocess samples in place, then convert them to the output
+       format with a vectorized kernel.
+    */
+
+    struct internal_state *state = strm->state;
+    uint32_t *start = state->flush_start;
+    uint32_t *end = MIN(state->rsip, state->rsi_buffer + state->line_len);
+    size_t n = end > start? end - start: 0;
+
+    if (state->pp) {
+        state->flush_wp = start;
+        flush_buf(strm);
+    }
+    state->pack(start, n, strm->next_out);
+    strm->next_out += n * state->bytes_per_sample;
+    state->flush_start = state->rsip;
+}
+
+static void flush_direct(struct aec_stream *strm)
+{
+    /**
+       Samples were decoded straight into next_out. Postprocess them
+       in place and advance the output.
+    */
+
+    struct internal_state *state = strm->state;
+    uint32_t *start = state->flush_start;
+    size_t n = state->rsip - start;
+
+    if (state->pp) {
+        state->flush_wp = start;
+        flush_buf(strm);
+    }
+    strm->next_out += n * sizeof(uint32_t);
+    state->flush_start = state->rsip;
+}
+
+static void select_rsi_buffer(struct aec_stream *strm)
+{
+    /**
+       Decode the next RSI into next_out if the whole RSI fits and
+       the output is aligned, otherwise stage it in rsi_alloc. Only
+       called at the start of an RSI when all output is flushed.
+    */
+
+    struct internal_state *state = strm->state;
+
+    if (strm->avail_out >= state->rsi_size * sizeof(uint32_t)
+        && (uintptr_t)strm->next_out % sizeof(uint32_t) == 0) {
+        state->rsi_buffer = (uint32_t *)strm->next_out;
+        state->flush_output = flush_direct;
+    } else {
+        state->rsi_buffer = state->rsi_alloc;
+        state->flush_output = state->flush_staged;
+    }
+    state->rsip = state->rsi_buffer;
+    state->flush_start = state->rsi_buffer;
+}
+
 static inline void check_rsi_end(struct aec_stream *strm)
 {
     /**
@@ -339,6 +413,207 @@ static inline uint32_t direct_get_fs(struct aec_stream *strm)
     return fs;
 }
 
+static inline void direct_skip(struct aec_stream *strm, size_t n)
+{
+    /**
+       Skip n bits of input stream.
+
+       No checking whatsoever.
+     */
+
+    struct internal_state *state = strm->state;
+
+    if (n <= (size_t)state->bitp) {
+        state->bitp -= (int)n;
+        return;
+    }
+
+    n -= state->bitp;
+    strm->next_in += n >> 3;
+    strm->avail_in -= n >> 3;
+    state->bitp = 0;
+    if (n & 7) {
+        state->acc = *strm->next_in++;
+        strm->avail_in--;
+        state->bitp = 8 - (n & 7);
+    }
+}
+
+static inline int popcount64(uint64_t x)
+{
+#if HAVE_DECL___BUILTIN_CLZLL || __has_builtin(__builtin_popcountll)
+    return __builtin_popcountll(x);
+#else
+    int n;
+
+    for (n = 0; x; n++)
+        x &= x - 1;
+    return n;
+#endif
+}
+
+static inline int ctz64(uint64_t x)
+{
+#if HAVE_DECL___BUILTIN_CLZLL || __has_builtin(__builtin_ctzll)
+    return __builtin_ctzll(x);
+#else
+    int n;
+
+    for (n = 0; (x & 1) == 0; n++)
+        x >>= 1;
+    return n;
+#endif
+}
+
+static inline int msb64(uint64_t x)
+{
+#if HAVE_DECL___BUILTIN_CLZLL || __has_builtin(__builtin_clzll)
+    return 63 - __builtin_clzll(x);
+#elif HAVE_BSR64
+    unsigned long i;
+    _BitScanReverse64(&i, x);
+    return (int)i;
+#else
+    int i = 63;
+
+    while ((x & (UINT64_C(1) << i)) == 0)
+        i--;
+    return i;
+#endif
+}
+
+static inline void direct_get_fs_block(struct aec_stream *strm,
+                                       uint32_t *out, size_t n, int k)
+{
+    /**
+       Decode n Fundamental Sequences into out, each shifted left by
+       k.
+
+       Accumulator and bit pointer are kept in registers. All FS
+       terminated within the current accumulator word are extracted
+       one after another by locating their 1 bit. The word is only
+       refilled once all its 1 bits have been used up.
+     */
+
+    struct internal_state *state = strm->state;
+    uint64_t acc;
+    uint32_t fs = 0;
+    int bitp = state->bitp;
+    int i;
+    size_t j;
+
+    acc = bitp? state->acc & (UINT64_MAX >> (64 - bitp)): 0;
+
+    for (j = 0; j < n; j++) {
+        while (acc == 0) {
+            acc = ((uint64_t)strm->next_in[0] << 48)
+                | ((uint64_t)strm->next_in[1] << 40)
+                | ((uint64_t)strm->next_in[2] << 32)
+                | ((uint64_t)strm->next_in[3] << 24)
+                | ((uint64_t)strm->next_in[4] << 16)
+                | ((uint64_t)strm->next_in[5] << 8)
+                | (uint64_t)strm->next_in[6];
+            strm->next_in += 7;
+            strm->avail_in -= 7;
+            fs += bitp;
+            bitp = 56;
+        }
+        i = msb64(acc);
+        out[j] = (fs + bitp - i - 1) << k;
+        fs = 0;
+        bitp = i;
+        acc ^= UINT64_C(1) << i;
+    }
+    state->acc = acc;
+    state->bitp = bitp;
+}
+
+static inline void direct_get_block(struct aec_stream *strm,
+                                    uint32_t *out, size_t n, int k)
+{
+    /**
+       Add n consecutive k bit values to out.
+
+       Unlike direct_get, the accumulator is refilled without
+       branching on the number of bytes. One unaligned 64 bit big
+       endian load tops it up to at least 56 bits, so the refill is
+       rare for small k. The load may read up to eight bytes ahead
+       which is covered by in_blklen.
+     */
+
+    struct internal_state *state = strm->state;
+    const unsigned char *p;
+    uint64_t acc = state->acc;
+    uint64_t w;
+    uint32_t mask = UINT32_MAX >> (32 - k);
+    int bitp = state->bitp;
+    int b;
+    size_t j;
+
+    for (j = 0; j < n; j++) {
+        if (bitp < k) {
+            p = strm->next_in;
+            w = ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48)
+                | ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32)
+                | ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16)
+                | ((uint64_t)p[6] << 8) | (uint64_t)p[7];
+            b = (63 - bitp) >> 3;
+            acc = (acc << (b << 3)) | (w >> (64 - (b << 3)));
+            strm->next_in += b;
+            strm->avail_in -= b;
+            bitp += b << 3;
+        }
+        bitp -= k;
+        out[j] += (uint32_t)(acc >> bitp) & mask;
+    }
+    state->acc = acc;
+    state->bitp = bitp;
+}
+
+static inline void direct_skip_fs(struct aec_stream *strm, uint32_t n)
+{
+    /**
+       Skip n Fundamental Sequences.
+
+       Whole accumulator words are skipped by counting their 1 bits.
+     */
+
+    struct internal_state *state = strm->state;
+    uint64_t acc;
+    int ones;
+
+    if (n == 0)
+        return;
+
+    if (state->bitp)
+        state->acc &= UINT64_MAX >> (64 - state->bitp);
+    else
+        state->acc = 0;
+
+    for (;;) {
+        ones = popcount64(state->acc);
+        if ((uint32_t)ones >= n)
+            break;
+        n -= ones;
+        state->acc = ((uint64_t)strm->next_in[0] << 48)
+            | ((uint64_t)strm->next_in[1] << 40)
+            | ((uint64_t)strm->next_in[2] << 32)
+            | ((uint64_t)strm->next_in[3] << 24)
+            | ((uint64_t)strm->next_in[4] << 16)
+            | ((uint64_t)strm->next_in[5] << 8)
+            | (uint64_t)strm->next_in[6];
+        strm->next_in += 7;
+        strm->avail_in -= 7;
+        state->bitp = 56;
+    }
+
+    /* The n-th 1 bit from the top terminates the last FS */
+    acc = state->acc;
+    for (ones -= n; ones > 0; ones--)
+        acc &= acc - 1;
+    state->bitp = ctz64(acc);
+}
+
 static inline uint32_t bits_ask(struct aec_stream *strm, int n)
 {
     while (strm->state->bitp < n) {
@@ -399,18 +674,50 @@ static inline uint32_t copysample(struct aec_stream *strm)
     return 1;
 }
 
+static inline void set_stats_option(struct internal_state *state,
+                                    int option, uint32_t blocks)
+{
+    state->stats_option = option;
+    state->stats_blocks = blocks;
+}
+
+static void count_cds(struct aec_stream *strm)
+{
+    /**
+       Add the CDS which ends at the current input position to the
+       statistics and start measuring the next one.
+
+       Inside aec_decode() total_in includes avail_in.
+    */
+
+    struct internal_state *state = strm->state;
+    size_t pos = (strm->total_in - strm->avail_in) * 8 - state->bitp;
+
+    stats_add(state->stats, state->stats_option, state->stats_blocks,
+              pos - state->stats_pos);
+    state->stats_option = STATS_NONE;
+    state->stats_pos = pos;
+}
+
 static int m_id(struct aec_stream *strm)
 {
     struct internal_state *state = strm->state;
 
     if (state->rsip == state->rsi_buffer) {
-        if(strm->flags & AEC_PAD_RSI)
+        if (state->direct_out)
+            select_rsi_buffer(strm);
+        if(strm->flags & AEC_PAD_RSI) {
+            /* Fill bits are not counted for the last CDS */
+            state->stats_pos += state->bitp % 8;
             state->bitp -= state->bitp % 8;
+        }
         if (state->pp)
             state->ref = 1;
     } else {
         state->ref = 0;
     }
+    if (state->stats)
+        count_cds(strm);
     if (bits_ask(strm, state->id_len) == 0)
         return M_EXIT;
     state->id = bits_get(strm, state->id_len);
@@ -461,25 +768,23 @@ static int m_split_fs(struct aec_stream *strm)
 
 static int m_split(struct aec_stream *strm)
 {
-    size_t i;
     int k;
     struct internal_state *state = strm->state;
 
+    set_stats_option(state, state->id - 1, 1);
     if (BUFFERSPACE(strm)) {
         k = state->id - 1;
 
         if (state->ref)
             *state->rsip++ = direct_get(strm, strm->bits_per_sample);
 
-        for (i = 0; i < strm->block_size - state->ref; i++)
-            state->rsip[i] = direct_get_fs(strm) << k;
+        direct_get_fs_block(strm, state->rsip,
+                            strm->block_size - state->ref, k);
 
-        if (k) {
-            for (i = state->ref; i < strm->block_size; i++)
-                *state->rsip++ += direct_get(strm, k);
-        } else {
-            state->rsip += strm->block_size - state->ref;
-        }
+        if (k)
+            direct_get_block(strm, state->rsip,
+                             strm->block_size - state->ref, k);
+        state->rsip += strm->block_size - state->ref;
 
         strm->avail_out -= state->out_blklen;
         check_rsi_end(strm);
@@ -531,6 +836,7 @@ static int m_zero_block(struct aec_stream *strm)
     } else if (zero_blocks > ROS) {
         zero_blocks--;
     }
+    set_stats_option(state, STATS_ZERO, zero_blocks);
 
     if (state->ref)
         i = zero_blocks * strm->block_size - 1;
@@ -557,6 +863,22 @@ static int m_zero_block(struct aec_stream *strm)
     return M_CONTINUE;
 }
 
+/* Second Extension option: FS value m of a pair of samples is mapped
+ * to the sum of both samples (even index) and the first FS value of
+ * that sum (odd index). */
+static const int se_table[182] = {
+    0, 0, 1, 1, 1, 1, 2, 3, 2, 3, 2, 3, 3, 6, 3, 6, 3, 6, 3, 6, 4, 10,
+    4, 10, 4, 10, 4, 10, 4, 10, 5, 15, 5, 15, 5, 15, 5, 15, 5, 15, 5, 15,
+    6, 21, 6, 21, 6, 21, 6, 21, 6, 21, 6, 21, 6, 21, 7, 28, 7, 28, 7, 28,
+    7, 28, 7, 28, 7, 28, 7, 28, 7, 28, 8, 36, 8, 36, 8, 36, 8, 36, 8, 36,
+    8, 36, 8, 36, 8, 36, 8, 36, 9, 45, 9, 45, 9, 45, 9, 45, 9, 45, 9, 45,
+    9, 45, 9, 45, 9, 45, 9, 45, 10, 55, 10, 55, 10, 55, 10, 55, 10, 55,
+    10, 55, 10, 55, 10, 55, 10, 55, 10, 55, 10, 55, 11, 66, 11, 66, 11, 66,
+    11, 66, 11, 66, 11, 66, 11, 66, 11, 66, 11, 66, 11, 66, 11, 66, 11, 66,
+    12, 78, 12, 78, 12, 78, 12, 78, 12, 78, 12, 78, 12, 78, 12, 78, 12, 78,
+    12, 78, 12, 78, 12, 78, 12, 78
+};
+
 static int m_se_decode(struct aec_stream *strm)
 {
     int32_t m, d1;
@@ -566,12 +888,12 @@ static int m_se_decode(struct aec_stream *strm)
         if (fs_ask(strm) == 0)
             return M_EXIT;
         m = state->fs;
-        d1 = m - state->se_table[2 * m + 1];
+        d1 = m - se_table[2 * m + 1];
 
         if ((state->i & 1) == 0) {
             if (strm->avail_out < state->bytes_per_sample)
                 return M_EXIT;
-            put_sample(strm, state->se_table[2 * m] - d1);
+            put_sample(strm, se_table[2 * m] - d1);
             state->i++;
         }
 
@@ -597,10 +919,10 @@ static int m_se(struct aec_stream *strm)
 
         while (i < strm->block_size) {
             m = direct_get_fs(strm);
-            d1 = m - state->se_table[2 * m + 1];
+            d1 = m - se_table[2 * m + 1];
 
             if ((i & 1) == 0) {
-                put_sample(strm, state->se_table[2 * m] - d1);
+                put_sample(strm, se_table[2 * m] - d1);
                 i++;
             }
             put_sample(strm, d1);
@@ -623,6 +945,7 @@ static int m_low_entropy_ref(struct aec_stream *strm)
         return M_EXIT;
 
     if(state->id == 1) {
+        set_stats_option(state, STATS_SE, 1);
         state->mode = m_se;
         return M_CONTINUE;
     }
@@ -661,6 +984,7 @@ static int m_uncomp(struct aec_stream *strm)
     size_t i;
     struct internal_state *state = strm->state;
 
+    set_stats_option(state, STATS_UNCOMP, 1);
     if (BUFFERSPACE(strm)) {
         for (i = 0; i < strm->block_size; i++)
             *state->rsip++ = direct_get(strm, strm->bits_per_sample);
@@ -676,35 +1000,83 @@ static int m_uncomp(struct aec_stream *strm)
     return M_CONTINUE;
 }
 
-static void create_se_table(int *table)
+/* Code option IDs mapped to states for all ID lengths. The lowest ID
+ * selects low entropy options, the highest no compression, all others
+ * splitting. */
+#define SPLIT2 m_split, m_split
+#define SPLIT6 SPLIT2, SPLIT2, SPLIT2
+#define SPLIT14 SPLIT6, SPLIT6, SPLIT2
+#define SPLIT30 SPLIT14, SPLIT14, SPLIT2
+
+static int (*const id_table_1[])(struct aec_stream *) = {
+    m_low_entropy, m_uncomp
+};
+static int (*const id_table_2[])(struct aec_stream *) = {
+    m_low_entropy, SPLIT2, m_uncomp
+};
+static int (*const id_table_3[])(struct aec_stream *) = {
+    m_low_entropy, SPLIT6, m_uncomp
+};
+static int (*const id_table_4[])(struct aec_stream *) = {
+    m_low_entropy, SPLIT14, m_uncomp
+};
+static int (*const id_table_5[])(struct aec_stream *) = {
+    m_low_entropy, SPLIT30, m_uncomp
+};
+
+static int (*const *const id_tables[])(struct aec_stream *) = {
+    NULL, id_table_1, id_table_2, id_table_3, id_table_4, id_table_5
+};
+
+static int check_config(const struct aec_stream *strm)
 {
-    int i, j, k, ms;
+    /**
+       Check the parameters of strm before any state is set up.
+    */
 
-    k = 0;
-    for (i = 0; i < 13; i++) {
-        ms = k;
-        for (j = 0; j <= i; j++) {
-            table[2 * k] = i;
-            table[2 * k + 1] = ms;
-            k++;
-        }
+    if (strm->bits_per_sample > 32 || strm->bits_per_sample == 0)
+        return AEC_CONF_ERROR;
+
+    /* The restricted set of options is defined up to 4 bit */
+    if (strm->flags & AEC_RESTRICTED && strm->bits_per_sample <= 8
+        && strm->bits_per_sample > 4)
+        return AEC_CONF_ERROR;
+
+    return AEC_OK;
+}
+
+static uint32_t sample_bytes(const struct aec_stream *strm)
+{
+    /**
+       Storage size of one output sample in bytes.
+    */
+
+    if (strm->bits_per_sample > 16) {
+        if (strm->bits_per_sample <= 24 && strm->flags & AEC_DATA_3BYTE)
+            return 3;
+        return 4;
     }
+    if (strm->bits_per_sample > 8)
+        return 2;
+    return 1;
 }
 
 int aec_decode_init(struct aec_stream *strm)
 {
-    int i, modi;
     struct internal_state *state;
+    struct aec_allocator alloc;
+    int status;
 
-    if (strm->bits_per_sample > 32 || strm->bits_per_sample == 0)
-        return AEC_CONF_ERROR;
+    status = check_config(strm);
+    if (status != AEC_OK)
+        return status;
 
-    state = malloc(sizeof(struct internal_state));
+    aec_allocator_init(&alloc, strm);
+    state = aec_alloc(&alloc, sizeof(struct internal_state));
     if (state == NULL)
         return AEC_MEM_ERROR;
     memset(state, 0, sizeof(struct internal_state));
-
-    create_se_table(state->se_table);
+    state->alloc = alloc;
 
     strm->state = state;
 
@@ -737,14 +1109,10 @@ int aec_decode_init(struct aec_stream *strm)
             state->flush_output = flush_lsb_16;
     } else {
         if (strm->flags & AEC_RESTRICTED) {
-            if (strm->bits_per_sample <= 4) {
-                if (strm->bits_per_sample <= 2)
-                    state->id_len = 1;
-                else
-                    state->id_len = 2;
-            } else {
-                return AEC_CONF_ERROR;
-            }
+            if (strm->bits_per_sample <= 2)
+                state->id_len = 1;
+            else
+                state->id_len = 2;
         } else {
             state->id_len = 3;
         }
@@ -754,8 +1122,13 @@ int aec_decode_init(struct aec_stream *strm)
         state->flush_output = flush_8;
     }
 
+    state->pack = aec_select_pack(state->bytes_per_sample,
+                                  strm->flags & AEC_DATA_MSB);
+    if (state->pack)
+        state->flush_output = flush_vector;
+
     if (strm->flags & AEC_DATA_SIGNED) {
-        state->xmax = UINT32_MAX >> (32 - strm->bits_per_sample + 1);
+        state->xmax = (UINT32_C(1) << (strm->bits_per_sample - 1)) - 1;
         state->xmin = ~state->xmax;
     } else {
         state->xmin = 0;
@@ -765,21 +1138,18 @@ int aec_decode_init(struct aec_stream *strm)
     state->in_blklen = (strm->block_size * strm->bits_per_sample
                         + state->id_len) / 8 + 9;
 
-    modi = 1UL << state->id_len;
-    state->id_table = malloc(modi * sizeof(int (*)(struct aec_stream *)));
-    if (state->id_table == NULL)
-        return AEC_MEM_ERROR;
-
-    state->id_table[0] = m_low_entropy;
-    for (i = 1; i < modi - 1; i++) {
-        state->id_table[i] = m_split;
-    }
-    state->id_table[modi - 1] = m_uncomp;
+    state->id_table = id_tables[state->id_len];
 
     state->rsi_size = strm->rsi * strm->block_size;
-    state->rsi_buffer = malloc(state->rsi_size * sizeof(uint32_t));
-    if (state->rsi_buffer == NULL)
+    state->line_len = state->rsi_size;
+    state->rsi_alloc = aec_alloc(&alloc,
+                                 state->rsi_size * sizeof(uint32_t));
+    if (state->rsi_alloc == NULL) {
+        aec_decode_end(strm);
         return AEC_MEM_ERROR;
+    }
+    state->rsi_buffer = state->rsi_alloc;
+    state->flush_staged = state->flush_output;
 
     state->ref = 0;
     strm->total_in = 0;
@@ -790,7 +1160,13 @@ int aec_decode_init(struct aec_stream *strm)
     state->bitp = 0;
     state->fs = 0;
     state->pp = strm->flags & AEC_DATA_PREPROCESS;
+    state->stats_option = STATS_NONE;
     state->mode = m_id;
+
+    state->bits_per_sample = strm->bits_per_sample;
+    state->block_size = strm->block_size;
+    state->rsi = strm->rsi;
+    state->flags = strm->flags;
     return AEC_OK;
 }
 
@@ -833,13 +1209,41 @@ int aec_decode(struct aec_stream *strm, int flush)
 int aec_decode_end(struct aec_stream *strm)
 {
     struct internal_state *state = strm->state;
+    struct aec_allocator alloc;
 
-    free(state->id_table);
-    free(state->rsi_buffer);
-    free(state);
+    if (state == NULL)
+        return AEC_STREAM_ERROR;
+
+    alloc = state->alloc;
+    aec_free(&alloc, state->rsi_alloc);
+    vector_destroy(&alloc, state->offsets);
+    stats_destroy(&alloc, state->stats);
+    aec_free(&alloc, state);
+    strm->state = NULL;
     return AEC_OK;
 }
 
+static void enable_direct_out(struct aec_stream *strm)
+{
+    /**
+       Decode RSIs straight into next_out if samples are stored as
+       native 32 bit integers.
+
+       This is only safe if the output buffer stays in place until
+       decoding has finished, as is the case for the buffer functions.
+     */
+
+    struct internal_state *state = strm->state;
+    int native;
+
+#ifdef WORDS_BIGENDIAN
+    native = (strm->flags & AEC_DATA_MSB) != 0;
+#else
+    native = (strm->flags & AEC_DATA_MSB) == 0;
+#endif
+    state->direct_out = native && state->bytes_per_sample == 4;
+}
+
 int aec_buffer_decode(struct aec_stream *strm)
 {
     int status;
@@ -848,7 +1252,649 @@ int aec_buffer_decode(struct aec_stream *strm)
     if (status != AEC_OK)
         return status;
 
+    enable_direct_out(strm);
     status = aec_decode(strm, AEC_FLUSH);
     aec_decode_end(strm);
     return status;
 }
+
+int aec_buffer_decode_lines(struct aec_stream *strm, size_t line_len)
+{
+    /**
+       Like aec_buffer_decode() but only the first line_len samples
+       of every RSI are written to next_out.
+
+       The decoder counts output space for all decoded samples while
+       flushing writes only those of the line. So avail_out is scaled
+       to the space the RSIs of the lines which fit would take, and
+       the space actually used is restored afterwards.
+    */
+
+    int status;
+    unsigned char *next_out;
+    size_t avail_out, line_bytes, rsi_bytes, lines;
+    struct internal_state *state;
+
+    if (line_len == 0 || line_len > (size_t)strm->rsi * strm->block_size)
+        return AEC_CONF_ERROR;
+
+    status = aec_decode_init(strm);
+    if (status != AEC_OK)
+        return status;
+
+    state = strm->state;
+    if (line_len == state->rsi_size)
+        enable_direct_out(strm);
+    state->line_len = line_len;
+
+    next_out = strm->next_out;
+    avail_out = strm->avail_out;
+    line_bytes = line_len * state->bytes_per_sample;
+    rsi_bytes = state->rsi_size * state->bytes_per_sample;
+    lines = avail_out / line_bytes;
+    if (lines < (size_t)-1 / rsi_bytes)
+        strm->avail_out = lines * rsi_bytes + avail_out % line_bytes;
+    else
+        strm->avail_out = ((size_t)-1 / rsi_bytes - 1) * rsi_bytes;
+
+    status = aec_decode(strm, AEC_FLUSH);
+    strm->total_out = strm->next_out - next_out;
+    strm->avail_out = avail_out - strm->total_out;
+    aec_decode_end(strm);
+    return status;
+}
+
+int aec_decode_enable_stats(struct aec_stream *strm)
+{
+    struct internal_state *state = strm->state;
+
+    if (state->stats != NULL)
+        return AEC_OK;
+
+    state->stats = stats_create(&state->alloc);
+    if (state->stats == NULL)
+        return AEC_MEM_ERROR;
+    return AEC_OK;
+}
+
+int aec_decode_get_stats(struct aec_stream *strm, struct aec_stats *stats)
+{
+    struct internal_state *state = strm->state;
+
+    if (state->stats == NULL)
+        return AEC_CONF_ERROR;
+
+    *stats = *state->stats;
+    return AEC_OK;
+}
+
+static void reset_rsi(struct aec_stream *strm)
+{
+    /**
+       Start over at the beginning of an RSI. The first sample decoded
+       will be the reference sample.
+     */
+
+    struct internal_state *state = strm->state;
+
+    state->rsip = state->rsi_buffer;
+    state->flush_start = state->rsi_buffer;
+    state->last_out = 0;
+    state->acc = 0;
+    state->bitp = 0;
+    state->fs = 0;
+    state->ref = 0;
+    state->i = 0;
+    state->n = 0;
+    state->stats_option = STATS_NONE;
+    state->mode = m_id;
+}
+
+int aec_buffer_seek(struct aec_stream *strm, size_t offset)
+{
+    /**
+       Position input at bit offset counted from next_in. Decoding
+       starts over at the beginning of the RSI found there.
+     */
+
+    struct internal_state *state = strm->state;
+    size_t byte_offset = offset / 8;
+    int bit_offset = offset % 8;
+
+    if (state == NULL)
+        return AEC_STREAM_ERROR;
+
+    if (strm->avail_in < byte_offset)
+        return AEC_DATA_ERROR;
+
+    reset_rsi(strm);
+
+    strm->next_in += byte_offset;
+    strm->avail_in -= byte_offset;
+
+    if (bit_offset > 0) {
+        if (strm->avail_in == 0)
+            return AEC_DATA_ERROR;
+        state->acc = *strm->next_in++;
+        state->bitp = 8 - bit_offset;
+        strm->avail_in--;
+    }
+    return AEC_OK;
+}
+
+int aec_decode_reset(struct aec_stream *strm)
+{
+    /**
+       Prepare an initialized decoder for a new stream.
+
+       Buffers and tables are kept if the parameters did not change,
+       otherwise the state is set up from scratch. The new
+       parameters are checked first, so that a reset with invalid
+       parameters keeps the decoder as it was.
+    */
+
+    struct internal_state *state = strm->state;
+    int status;
+
+    if (state == NULL)
+        return AEC_STREAM_ERROR;
+
+    if (strm->bits_per_sample != state->bits_per_sample
+        || strm->block_size != state->block_size
+        || strm->rsi != state->rsi
+        || strm->flags != state->flags) {
+        status = check_config(strm);
+        if (status != AEC_OK)
+            return status;
+        aec_decode_end(strm);
+        return aec_decode_init(strm);
+    }
+
+    state->rsi_buffer = state->rsi_alloc;
+    state->flush_output = state->flush_staged;
+    state->direct_out = 0;
+    state->line_len = state->rsi_size;
+    reset_rsi(strm);
+    vector_destroy(&state->alloc, state->offsets);
+    state->offsets = NULL;
+    stats_clear(state->stats);
+    strm->total_in = 0;
+    strm->total_out = 0;
+    return AEC_OK;
+}
+
+int aec_buffer_decode_ctx(struct aec_stream *strm)
+{
+    /**
+       Like aec_buffer_decode() but with an initialized decoder which
+       is kept for further calls.
+    */
+
+    int status;
+
+    status = aec_decode_reset(strm);
+    if (status != AEC_OK)
+        return status;
+    enable_direct_out(strm);
+    return aec_decode(strm, AEC_FLUSH);
+}
+
+int aec_decode_range(struct aec_stream *strm,
+                     const size_t *rsi_offsets, size_t rsi_offsets_count,
+                     size_t pos, size_t size)
+{
+    /**
+       Decode size bytes of output starting at byte pos.
+
+       Decoding starts at the RSI containing pos. Samples of that RSI
+       preceding pos are decoded into a small scratch buffer and
+       dropped. Input is left untouched so that ranges can be
+       requested repeatedly.
+     */
+
+    struct internal_state *state = strm->state;
+    const unsigned char *next_in = strm->next_in;
+    size_t avail_in = strm->avail_in;
+    size_t total_in = strm->total_in;
+    size_t total_out = strm->total_out;
+    unsigned char *next_out = strm->next_out;
+    size_t avail_out = strm->avail_out;
+    unsigned char scratch[4096];
+    size_t rsi_bytes, rsi_n, skip, n;
+    int status;
+
+    if (pos % state->bytes_per_sample || size % state->bytes_per_sample)
+        return AEC_CONF_ERROR;
+
+    if (avail_out < size)
+        return AEC_MEM_ERROR;
+
+    rsi_bytes = state->rsi_size * state->bytes_per_sample;
+    rsi_n = pos / rsi_bytes;
+    if (rsi_n >= rsi_offsets_count)
+        return AEC_DATA_ERROR;
+
+    status = aec_buffer_seek(strm, rsi_offsets[rsi_n]);
+
+    skip = pos - rsi_n * rsi_bytes;
+    while (status == AEC_OK && skip > 0) {
+        n = MIN(skip, sizeof(scratch)
+                - sizeof(scratch) % state->bytes_per_sample);
+        strm->next_out = scratch;
+        strm->avail_out = n;
+        status = aec_decode(strm, AEC_FLUSH);
+        if (status == AEC_OK && strm->avail_out == n)
+            status = AEC_DATA_ERROR;
+        skip -= n - strm->avail_out;
+    }
+
+    strm->next_out = next_out;
+    strm->avail_out = size;
+    if (status == AEC_OK)
+        status = aec_decode(strm, AEC_FLUSH);
+    n = size - strm->avail_out;
+
+    strm->next_in = next_in;
+    strm->avail_in = avail_in;
+    strm->total_in = total_in;
+    strm->next_out = next_out + n;
+    strm->avail_out = avail_out - n;
+    strm->total_out = total_out + n;
+    return status;
+}
+
+static void scan_cds(struct aec_stream *strm, uint32_t *samples)
+{
+    /**
+       Skip one Coded Data Set.
+
+       Only the lengths of IDs, FS and binary parts are evaluated. No
+       samples are written. samples counts the samples of the current
+       RSI.
+     */
+
+    struct internal_state *state = strm->state;
+    uint32_t b, zero_blocks;
+    int id, k;
+
+    id = direct_get(strm, state->id_len);
+    if (id == 0) {
+        id = direct_get(strm, 1);
+        if (state->ref)
+            direct_skip(strm, strm->bits_per_sample);
+
+        if (id == 1) {
+            /* Second Extension codes pairs of samples. With a
+             * reference sample the first FS codes a single sample. */
+            direct_skip_fs(strm, strm->block_size / 2);
+            *samples += strm->block_size;
+        } else {
+            /* zero blocks */
+            zero_blocks = direct_get_fs(strm) + 1;
+            if (zero_blocks == ROS) {
+                b = *samples / strm->block_size;
+                zero_blocks = MIN(strm->rsi - b, 64 - (b % 64));
+            } else if (zero_blocks > ROS) {
+                zero_blocks--;
+            }
+            *samples += zero_blocks * strm->block_size;
+        }
+    } else if (id == (1 << state->id_len) - 1) {
+        /* uncompressed */
+        direct_skip(strm, strm->block_size * strm->bits_per_sample);
+        *samples += strm->block_size;
+    } else {
+        /* splitting */
+        k = id - 1;
+        if (state->ref)
+            direct_skip(strm, strm->bits_per_sample);
+        direct_skip_fs(strm, strm->block_size - state->ref);
+        direct_skip(strm, (strm->block_size - state->ref) * k);
+        *samples += strm->block_size;
+    }
+}
+
+static inline size_t scan_pos(struct aec_stream *strm,
+                              const unsigned char *start, size_t start_pos)
+{
+    /**
+       Bit position in input. start is at byte start_pos.
+     */
+
+    return (start_pos + (size_t)(strm->next_in - start)) * 8
+        - strm->state->bitp;
+}
+
+int aec_decode_scan_offsets(struct aec_stream *strm)
+{
+    /**
+       Find the bit offsets of all RSIs without decoding.
+
+       CDSs are skipped with the fast direct functions. Once less than
+       the length of an uncompressed block is left, the remaining
+       input is copied to a buffer padded with 1 bits. Every CDS read
+       from there terminates within the padding. The stream ends with
+       the first CDS which doesn't fit into the real input.
+     */
+
+    struct internal_state *state = strm->state;
+    const unsigned char *next_in = strm->next_in;
+    size_t avail_in = strm->avail_in;
+    const unsigned char *start;
+    unsigned char *tail;
+    size_t tail_start, tail_len, offset;
+    uint32_t samples;
+    int first, status;
+
+    vector_destroy(&state->alloc, state->offsets);
+    state->offsets = vector_create(&state->alloc);
+    if (state->offsets == NULL)
+        return AEC_MEM_ERROR;
+
+    reset_rsi(strm);
+    start = strm->next_in;
+    tail = NULL;
+    tail_start = 0;
+    status = AEC_OK;
+
+    for (;;) {
+        if (strm->flags & AEC_PAD_RSI)
+            state->bitp -= state->bitp % 8;
+        offset = scan_pos(strm, start, tail_start);
+        state->ref = state->pp? 1: 0;
+        samples = 0;
+        first = 1;
+
+        while (samples < state->rsi_size) {
+            if (tail == NULL && strm->avail_in < state->in_blklen) {
+                tail_start = strm->next_in - start;
+                tail_len = strm->avail_in + state->in_blklen + 8;
+                tail = aec_alloc(&state->alloc, tail_len);
+                if (tail == NULL) {
+                    status = AEC_MEM_ERROR;
+                    goto EXIT;
+                }
+                memcpy(tail, strm->next_in, strm->avail_in);
+                memset(tail + strm->avail_in, 0xff,
+                       tail_len - strm->avail_in);
+                strm->next_in = tail;
+                start = tail;
+                strm->avail_in = tail_len;
+            }
+
+            scan_cds(strm, &samples);
+            if (scan_pos(strm, start, tail_start) > avail_in * 8)
+                goto EXIT;
+
+            if (samples > state->rsi_size) {
+                status = AEC_DATA_ERROR;
+                goto EXIT;
+            }
+
+            /* Only RSIs with at least one complete CDS count */
+            if (first) {
+                first = 0;
+                if (vector_push_back(&state->alloc, state->offsets,
+                                     offset)) {
+                    status = AEC_MEM_ERROR;
+                    goto EXIT;
+                }
+            }
+            state->ref = 0;
+        }
+    }
+
+EXIT:
+    aec_free(&state->alloc, tail);
+    strm->next_in = next_in;
+    strm->avail_in = avail_in;
+    reset_rsi(strm);
+    return status;
+}
+
+int aec_decode_count_offsets(struct aec_stream *strm, size_t *count)
+{
+    struct internal_state *state = strm->state;
+
+    if (state->offsets == NULL)
+        return AEC_RSI_OFFSETS_ERROR;
+
+    *count = vector_size(state->offsets);
+    return AEC_OK;
+}
+
+int aec_decode_get_offsets(struct aec_stream *strm,
+                           size_t *offsets, size_t count)
+{
+    struct internal_state *state = strm->state;
+
+    if (state->offsets == NULL)
+        return AEC_RSI_OFFSETS_ERROR;
+
+    if (count < vector_size(state->offsets))
+        return AEC_MEM_ERROR;
+
+    memcpy(offsets, vector_data(state->offsets),
+           vector_size(state->offsets) * sizeof(size_t));
+    return AEC_OK;
+}
+
+struct decode_chunk {
+    struct aec_stream strm;
+
+    /* bit offset of first RSI in chunk */
+    size_t offset;
+
+    int status;
+};
+
+static void decode_chunk(void *arg, size_t n)
+{
+    struct decode_chunk *chunk = (struct decode_chunk *)arg + n;
+    struct aec_stream *strm = &chunk->strm;
+    size_t total_in;
+    int status;
+
+    status = aec_decode_init(strm);
+    if (status == AEC_OK) {
+        enable_direct_out(strm);
+        total_in = strm->avail_in;
+        status = aec_buffer_seek(strm, chunk->offset);
+        if (status == AEC_OK)
+            status = aec_decode(strm, AEC_FLUSH);
+        strm->total_in = total_in - strm->avail_in;
+        aec_decode_end(strm);
+    }
+    chunk->status = status;
+}
+
+static int buffer_decode_mt(struct aec_stream *strm,
+                            const size_t *rsi_offsets,
+                            size_t rsi_offsets_count,
+                            struct aec_pool *pool, int nthreads)
+{
+    /**
+       Decode a memory buffer with several threads.
+
+       The bit offsets of RSIs as recorded by the encoder tell where
+       each RSI starts. Chunks of consecutive RSIs are decoded
+       concurrently straight into their final place in next_out.
+     */
+
+    struct decode_chunk *chunks;
+    struct aec_allocator alloc;
+    size_t rsi_size, nchunks, rsi_per_chunk, first, out_pos, i;
+    int status;
+
+    nthreads = aec_thread_count(pool, nthreads);
+    if (nthreads < 2 || rsi_offsets_count < 2)
+        return aec_buffer_decode(strm);
+
+    status = check_config(strm);
+    if (status != AEC_OK)
+        return status;
+    rsi_size = strm->rsi * strm->block_size * sample_bytes(strm);
+
+    nchunks = MIN(rsi_offsets_count, (size_t)nthreads * 4);
+    rsi_per_chunk = (rsi_offsets_count + nchunks - 1) / nchunks;
+    nchunks = (rsi_offsets_count + rsi_per_chunk - 1) / rsi_per_chunk;
+
+    aec_allocator_init(&alloc, strm);
+    chunks = aec_alloc(&alloc, nchunks * sizeof(struct decode_chunk));
+    if (chunks == NULL)
+        return AEC_MEM_ERROR;
+    memset(chunks, 0, nchunks * sizeof(struct decode_chunk));
+
+    for (i = 0; i < nchunks; i++) {
+        first = i * rsi_per_chunk;
+        out_pos = MIN(first * rsi_size, strm->avail_out);
+        chunks[i].strm = *strm;
+        chunks[i].offset = rsi_offsets[first];
+        chunks[i].strm.next_out = strm->next_out + out_pos;
+        if (i == nchunks - 1)
+            chunks[i].strm.avail_out = strm->avail_out - out_pos;
+        else
+            chunks[i].strm.avail_out =
+                MIN(rsi_per_chunk * rsi_size, strm->avail_out - out_pos);
+    }
+
+    aec_parallel_for(pool, nthreads, nchunks, decode_chunk, chunks);
+
+    status = AEC_OK;
+    strm->total_in = 0;
+    strm->total_out = 0;
+    for (i = 0; i < nchunks; i++) {
+        if (chunks[i].status != AEC_OK) {
+            status = chunks[i].status;
+            break;
+        }
+        /* Only the last chunk may end early */
+        if (i < nchunks - 1 && chunks[i].strm.avail_out > 0) {
+            status = AEC_DATA_ERROR;
+            break;
+        }
+        strm->total_out += chunks[i].strm.total_out;
+        strm->total_in = MAX(strm->total_in, chunks[i].strm.total_in);
+    }
+
+    if (status == AEC_OK) {
+        strm->next_in += strm->total_in;
+        strm->avail_in -= strm->total_in;
+        strm->next_out += strm->total_out;
+        strm->avail_out -= strm->total_out;
+    }
+    aec_free(&alloc, chunks);
+    return status;
+}
+
+int aec_buffer_decode_mt(struct aec_stream *strm,
+                         const size_t *rsi_offsets, size_t rsi_offsets_count,
+                         int nthreads)
+{
+    return buffer_decode_mt(strm, rsi_offsets, rsi_offsets_count,
+                            NULL, nthreads);
+}
+
+int aec_buffer_decode_pool(struct aec_stream *strm,
+                           const size_t *rsi_offsets,
+                           size_t rsi_offsets_count,
+                           struct aec_pool *pool)
+{
+    return buffer_decode_mt(strm, rsi_offsets, rsi_offsets_count, pool, 0);
+}
+
+struct decode_batch {
+    /* stream with shared parameters */
+    const struct aec_stream *strm;
+
+    struct aec_buffer *buffers;
+    size_t count;
+
+    /* buffers coded by one job */
+    size_t per_job;
+};
+
+static void decode_batch_job(void *arg, size_t n)
+{
+    /**
+       Code consecutive buffers of a batch with one stream which is
+       set up only once.
+     */
+
+    struct decode_batch *batch = arg;
+    struct aec_stream strm = *batch->strm;
+    struct aec_buffer *buf;
+    size_t i, end;
+    int status;
+
+    i = n * batch->per_job;
+    end = MIN(i + batch->per_job, batch->count);
+    status = aec_decode_init(&strm);
+    for (; i < end; i++) {
+        buf = &batch->buffers[i];
+        buf->total_out = 0;
+        buf->status = status;
+        if (status != AEC_OK)
+            continue;
+        strm.next_in = buf->next_in;
+        strm.avail_in = buf->avail_in;
+        strm.next_out = buf->next_out;
+        strm.avail_out = buf->avail_out;
+        buf->status = aec_buffer_decode_ctx(&strm);
+        if (buf->status == AEC_OK)
+            buf->total_out = strm.total_out;
+    }
+    if (status == AEC_OK)
+        aec_decode_end(&strm);
+}
+
+static int buffer_decode_batch(struct aec_stream *strm,
+                               struct aec_buffer *buffers, size_t count,
+                               struct aec_pool *pool, int nthreads)
+{
+    /**
+       Decode independent buffers with the parameters of strm.
+
+       Buffers are handed out in groups to up to nthreads threads.
+       Every group is coded with one stream, so the state is set up
+       once per group instead of once per buffer.
+     */
+
+    struct decode_batch batch;
+    size_t njobs, i;
+
+    if (count == 0)
+        return AEC_OK;
+
+    nthreads = aec_thread_count(pool, nthreads);
+
+    /* A few groups per thread even out differences in coding
+     * speed. */
+    njobs = nthreads < 2 ? 1 : MIN(count, (size_t)nthreads * 4);
+    batch.strm = strm;
+    batch.buffers = buffers;
+    batch.count = count;
+    batch.per_job = (count + njobs - 1) / njobs;
+    njobs = (count + batch.per_job - 1) / batch.per_job;
+
+    aec_parallel_for(pool, nthreads, njobs, decode_batch_job, &batch);
+
+    for (i = 0; i < count; i++)
+        if (buffers[i].status != AEC_OK)
+            return buffers[i].status;
+    return AEC_OK;
+}
+
+int aec_buffer_decode_batch(struct aec_stream *strm,
+                            struct aec_buffer *buffers, size_t count,
+                            int nthreads)
+{
+    return buffer_decode_batch(strm, buffers, count, NULL, nthreads);
+}
+
+int aec_buffer_decode_batch_pool(struct aec_stream *strm,
+                                 struct aec_buffer *buffers, size_t count,
+                                 struct aec_pool *pool)
+{
+    return buffer_decode_batch(strm, buffers, count, pool, 0);
+}
@@ -52,16 +52,20 @@
 #define DECODE_H 1
 
 #include <config.h>
+#include <stddef.h>
 
 #if HAVE_STDINT_H
 #  include <stdint.h>
 #endif
 
+#include "alloc.h"
+
 #define M_CONTINUE 1
 #define M_EXIT 0
 #define M_ERROR (-1)
 
 #define MIN(a, b) (((a) < (b))? (a): (b))
+#define MAX(a, b) (((a) > (b))? (a): (b))
 
 struct aec_stream;
 
@@ -75,10 +79,13 @@ struct internal_state {
     int id_len;
 
     /* table maps IDs to states */
-    int (**id_table)(struct aec_stream *);
+    int (*const *id_table)(struct aec_stream *);
 
     void (*flush_output)(struct aec_stream *);
 
+    /* vectorized conversion of samples to output format or NULL */
+    void (*pack)(const uint32_t *src, size_t n, unsigned char *dst);
+
     /* previous output for post-processing */
     int32_t last_out;
 
@@ -116,20 +123,57 @@ struct internal_state {
     /* storage size of samples in bytes */
     uint32_t bytes_per_sample;
 
-    /* output buffer holding one reference sample interval */
+    /* output buffer of the current reference sample interval, either
+     * rsi_alloc or next_out */
     uint32_t *rsi_buffer;
 
+    /* allocated buffer holding one reference sample interval */
+    uint32_t *rsi_alloc;
+
+    /* flush_output for RSIs decoded into rsi_alloc */
+    void (*flush_staged)(struct aec_stream *);
+
+    /* RSIs are decoded straight into next_out if they fit (1) */
+    int direct_out;
+
     /* current position of output in rsi_buffer */
     uint32_t *rsip;
 
     /* rsi in bytes */
     size_t rsi_size;
 
+    /* samples at the start of each RSI which are written to the
+     * output, the rest is dropped as padding */
+    size_t line_len;
+
     /* first not yet flushed byte in rsi_buffer */
     uint32_t *flush_start;
 
-    /* table for decoding second extension option */
-    int se_table[182];
+    /* write position of in place postprocessing */
+    uint32_t *flush_wp;
+
+    /* allocation functions the state was set up with */
+    struct aec_allocator alloc;
+
+    /* parameters the state was set up for */
+    unsigned int bits_per_sample;
+    unsigned int block_size;
+    unsigned int rsi;
+    unsigned int flags;
+
+    /* bit offsets of RSIs found by scanning or NULL */
+    struct vector_t *offsets;
+
+    /* code option statistics or NULL if disabled */
+    struct aec_stats *stats;
+
+    /* code option and number of blocks of the CDS being decoded,
+     * counted when the next CDS starts */
+    int stats_option;
+    uint32_t stats_blocks;
+
+    /* input bit position where the CDS being decoded started */
+    size_t stats_pos;
 } decode_state;
 
 #endif /* DECODE_H */
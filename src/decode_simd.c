@@ -0,0 +1,204 @@
+/**
+ * @file decode_simd.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Vectorized kernels for the decoder with runtime dispatch
+ *
+ */
+
+#include <config.h>
+
+#if HAVE_STDINT_H
+#  include <stdint.h>
+#endif
+
+#include "decode_simd.h"
+
+#if HAVE_SSSE3 || HAVE_AVX2
+#  include <immintrin.h>
+
+/* Byte shuffles selecting the output bytes of four 32 bit samples.
+ * Rows are indexed by bytes_per_sample - 1 + 4 * msb. */
+static const int8_t shuf_tab[8][16] = {
+    { 0,  4,  8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  1,  4,  5,  8,  9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  1,  2,  4,  5,  6,  8,  9, 10, 12, 13, 14, -1, -1, -1, -1},
+    { 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15},
+    { 0,  4,  8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  0,  5,  4,  9,  8, 13, 12, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 2,  1,  0,  6,  5,  4, 10,  9,  8, 14, 13, 12, -1, -1, -1, -1},
+    { 3,  2,  1,  0,  7,  6,  5,  4, 11, 10,  9,  8, 15, 14, 13, 12}
+};
+
+#if HAVE_AVX2
+/* Positions of the valid 32 bit words after the shuffle of eight
+ * samples in two lanes */
+static const int32_t perm_tab[4][8] = {
+    {0, 4, 0, 0, 0, 0, 0, 0},
+    {0, 1, 4, 5, 0, 0, 0, 0},
+    {0, 1, 2, 4, 5, 6, 0, 0},
+    {0, 1, 2, 3, 4, 5, 6, 7}
+};
+#endif
+
+static inline void pack_scalar(const uint32_t *src, size_t n,
+                               unsigned char *dst, int bytes, int msb)
+{
+    size_t i;
+    int j;
+
+    for (i = 0; i < n; i++)
+        for (j = 0; j < bytes; j++)
+            *dst++ = (unsigned char)(
+                src[i] >> (8 * (msb? bytes - 1 - j: j)));
+}
+#endif
+
+#if HAVE_SSSE3
+__attribute__((target("ssse3")))
+static inline void pack_ssse3(const uint32_t *src, size_t n,
+                              unsigned char *dst, int bytes, int msb)
+{
+    /**
+       Each store writes 16 bytes of which only 4 * bytes are
+       valid. The vector loop stops early enough not to write past
+       the end of the output.
+    */
+
+    size_t i;
+    const __m128i shuf = _mm_loadu_si128(
+        (const __m128i *)shuf_tab[bytes - 1 + 4 * msb]);
+
+    for (i = 0; i + 4 <= n && (n - i) * bytes >= 16; i += 4) {
+        _mm_storeu_si128((__m128i *)dst,
+                         _mm_shuffle_epi8(
+                             _mm_loadu_si128((const __m128i *)(src + i)),
+                             shuf));
+        dst += 4 * bytes;
+    }
+    pack_scalar(src + i, n - i, dst, bytes, msb);
+}
+#endif /* HAVE_SSSE3 */
+
+#if HAVE_AVX2
+__attribute__((target("avx2")))
+static inline void pack_avx2(const uint32_t *src, size_t n,
+                             unsigned char *dst, int bytes, int msb)
+{
+    /**
+       The shuffle works within 128 bit lanes. A permutation moves
+       the valid 32 bit words of the upper lane next to those of the
+       lower lane.
+    */
+
+    size_t i;
+    const __m256i shuf = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)shuf_tab[bytes - 1 + 4 * msb]));
+    const __m256i perm = _mm256_loadu_si256(
+        (const __m256i *)perm_tab[bytes - 1]);
+    __m256i v;
+
+    for (i = 0; i + 8 <= n && (n - i) * bytes >= 32; i += 8) {
+        v = _mm256_shuffle_epi8(
+            _mm256_loadu_si256((const __m256i *)(src + i)), shuf);
+        _mm256_storeu_si256((__m256i *)dst,
+                            _mm256_permutevar8x32_epi32(v, perm));
+        dst += 8 * bytes;
+    }
+    pack_scalar(src + i, n - i, dst, bytes, msb);
+}
+#endif /* HAVE_AVX2 */
+
+#define PACK(KIND, BYTES, MSB, ISA)                                      \
+    __attribute__((target(#ISA)))                                        \
+    static void pack_##KIND##_##ISA(const uint32_t *src, size_t n,       \
+                                    unsigned char *dst)                  \
+    {                                                                    \
+        pack_##ISA(src, n, dst, BYTES, MSB);                             \
+    }
+
+#if HAVE_SSSE3
+PACK(8, 1, 0, ssse3)
+PACK(lsb_16, 2, 0, ssse3)
+PACK(lsb_24, 3, 0, ssse3)
+PACK(lsb_32, 4, 0, ssse3)
+PACK(msb_16, 2, 1, ssse3)
+PACK(msb_24, 3, 1, ssse3)
+PACK(msb_32, 4, 1, ssse3)
+#endif
+
+#if HAVE_AVX2
+PACK(8, 1, 0, avx2)
+PACK(lsb_16, 2, 0, avx2)
+PACK(lsb_24, 3, 0, avx2)
+PACK(lsb_32, 4, 0, avx2)
+PACK(msb_16, 2, 1, avx2)
+PACK(msb_24, 3, 1, avx2)
+PACK(msb_32, 4, 1, avx2)
+#endif
+
+#define SELECT_PACK(ISA)                                                 \
+    do {                                                                 \
+        static const aec_pack_t tab[8] = {                               \
+            pack_8_##ISA, pack_lsb_16_##ISA,                             \
+            pack_lsb_24_##ISA, pack_lsb_32_##ISA,                        \
+            pack_8_##ISA, pack_msb_16_##ISA,                             \
+            pack_msb_24_##ISA, pack_msb_32_##ISA                         \
+        };                                                               \
+        if (__builtin_cpu_supports(#ISA))                                \
+            return tab[bytes_per_sample - 1 + 4 * (msb != 0)];           \
+    } while (0)
+
+aec_pack_t aec_select_pack(uint32_t bytes_per_sample, int msb)
+{
+#if HAVE_AVX2
+    SELECT_PACK(avx2);
+#endif
+#if HAVE_SSSE3
+    SELECT_PACK(ssse3);
+#endif
+    (void)bytes_per_sample;
+    (void)msb;
+    return NULL;
+}
@@ -52,9 +52,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "alloc.h"
 #include "encode.h"
 #include "encode_accessors.h"
+#include "encode_simd.h"
 #include "libaec.h"
+#include "stats.h"
+#include "threads.h"
+#include "vector.h"
 
 static int m_get_block(struct aec_stream *strm);
 
@@ -115,7 +120,8 @@ static inline void copy64(uint8_t *dst, uint64_t src)
     dst[7] = (uint8_t)src;
 }
 
-static inline void emitblock_fs(struct aec_stream *strm, int k, int ref)
+static inline void emitblock_fs(struct aec_stream *strm, uint32_t bs,
+                                int k, int ref)
 {
     size_t i;
     uint32_t used; /* used bits in 64 bit accumulator */
@@ -125,7 +131,7 @@ static inline void emitblock_fs(struct aec_stream *strm, int k, int ref)
     acc = (uint64_t)*state->cds << 56;
     used = 7 - state->bits;
 
-    for (i = ref; i < strm->block_size; i++) {
+    for (i = ref; i < bs; i++) {
         used += (state->block[i] >> k) + 1;
         while (used > 63) {
             copy64(state->cds, acc);
@@ -141,7 +147,8 @@ static inline void emitblock_fs(struct aec_stream *strm, int k, int ref)
     state->bits = 7 - (used & 7);
 }
 
-static inline void emitblock(struct aec_stream *strm, int k, int ref)
+static inline void emitblock(struct aec_stream *strm, uint32_t bs,
+                             int k, int ref)
 {
     /**
        Emit the k LSB of a whole block of input data.
@@ -150,7 +157,7 @@ static inline void emitblock(struct aec_stream *strm, int k, int ref)
     uint64_t a;
     struct internal_state *state = strm->state;
     uint32_t *in = state->block + ref;
-    uint32_t *in_end = state->block + strm->block_size;
+    uint32_t *in_end = state->block + bs;
     uint64_t mask = (UINT64_C(1) << k) - 1;
     uint8_t *o = state->cds;
     int p = state->bits;
@@ -232,27 +239,26 @@ static inline void emitblock(struct aec_stream *strm, int k, int ref)
     state->bits = p % 8;
 }
 
-static void preprocess_unsigned(struct aec_stream *strm)
+static void preprocess_unsigned(struct internal_state *state,
+                                const uint32_t *restrict x,
+                                uint32_t *restrict d, size_t n)
 {
     /**
-       Preprocess RSI of unsigned samples.
+       Map n unsigned samples x[1..n] to d[1..n] using their
+       predecessors x[0..n-1].
 
-       Combining preprocessing and converting to uint32_t in one loop
-       is slower due to the data dependance on x_i-1.
+       A vectorized kernel handles the bulk of the samples if
+       available.
     */
 
     uint32_t D;
-    struct internal_state *state = strm->state;
-    const uint32_t *restrict x = state->data_raw;
-    uint32_t *restrict d = state->data_pp;
     uint32_t xmax = state->xmax;
-    uint32_t rsi = strm->rsi * strm->block_size - 1;
-    size_t i;
+    size_t i = 0;
 
-    state->ref = 1;
-    state->ref_sample = x[0];
-    d[0] = 0;
-    for (i = 0; i < rsi; i++) {
+    if (state->preprocess_kernel)
+        i = state->preprocess_kernel(x, d, n, 0, xmax, 0);
+
+    for (; i < n; i++) {
         if (x[i + 1] >= x[i]) {
             D = x[i + 1] - x[i];
             if (D <= x[i])
@@ -267,50 +273,110 @@ static void preprocess_unsigned(struct aec_stream *strm)
                 d[i + 1] = xmax - x[i + 1];
         }
     }
-    state->uncomp_len = (strm->block_size - 1) * strm->bits_per_sample;
 }
 
-static void preprocess_signed(struct aec_stream *strm)
+static void preprocess_signed(struct internal_state *state,
+                              const uint32_t *restrict x,
+                              uint32_t *restrict d, size_t n)
 {
     /**
-       Preprocess RSI of signed samples.
+       Map n signed samples x[1..n] to d[1..n] using their
+       predecessors x[0..n-1]. Samples are sign extended on the fly
+       so the strip keeps the input as read. Bits above
+       bits_per_sample are ignored, samples may be stored sign
+       extended or not.
     */
 
     uint32_t D;
-    struct internal_state *state = strm->state;
-    int32_t *restrict x = (int32_t *)state->data_raw;
-    uint32_t *restrict d = state->data_pp;
+    int32_t a, b;
     int32_t xmax = (int32_t)state->xmax;
     int32_t xmin = (int32_t)state->xmin;
-    uint32_t rsi = strm->rsi * strm->block_size - 1;
-    uint32_t m = UINT64_C(1) << (strm->bits_per_sample - 1);
-    size_t i;
-
-    state->ref = 1;
-    state->ref_sample = x[0];
-    d[0] = 0;
-    x[0] = (x[0] ^ m) - m;
-
-    for (i = 0; i < rsi; i++) {
-        x[i + 1] = (x[i + 1] ^ m) - m;
-        if (x[i + 1] < x[i]) {
-            D = (uint32_t)(x[i] - x[i + 1]);
-            if (D <= (uint32_t)(xmax - x[i]))
+    uint32_t m = state->xmax + 1;
+    uint32_t mask = state->xmax - state->xmin;
+    size_t i = 0;
+
+    if (state->preprocess_kernel)
+        i = state->preprocess_kernel(x, d, n,
+                                     state->xmin, state->xmax, m);
+
+    for (; i < n; i++) {
+        a = (int32_t)(((x[i] & mask) ^ m) - m);
+        b = (int32_t)(((x[i + 1] & mask) ^ m) - m);
+        /* Differences may exceed int32_t, compute them unsigned */
+        if (b < a) {
+            D = (uint32_t)a - (uint32_t)b;
+            if (D <= (uint32_t)xmax - (uint32_t)a)
                 d[i + 1] = 2 * D - 1;
             else
-                d[i + 1] = xmax - x[i + 1];
+                d[i + 1] = (uint32_t)xmax - (uint32_t)b;
         } else {
-            D = (uint32_t)(x[i + 1] - x[i]);
-            if (D <= (uint32_t)(x[i] - xmin))
+            D = (uint32_t)b - (uint32_t)a;
+            if (D <= (uint32_t)a - (uint32_t)xmin)
                 d[i + 1] = 2 * D;
             else
-                d[i + 1] = x[i + 1] - xmin;
+                d[i + 1] = (uint32_t)b - (uint32_t)xmin;
         }
     }
+}
+
+static void preprocess_rsi(struct aec_stream *strm, size_t len,
+                           int direct)
+{
+    /**
+       Preprocess the first len samples of an RSI into data_pp.
+
+       Samples are converted and mapped in strips of PP_STRIP samples
+       which stay in L1 cache, so the RSI is written to memory only
+       once. If direct is set, samples are read from next_in,
+       otherwise data_pp already holds the converted samples and is
+       mapped in place. Aligned native 32 bit samples need no
+       conversion and are mapped straight from next_in.
+    */
+
+    struct internal_state *state = strm->state;
+    uint32_t *restrict x = state->pp_strip;
+    uint32_t *restrict d = state->data_pp;
+    size_t rsi = len - 1;
+    size_t n, s;
+    /* bits above bits_per_sample, like those of sign extended
+     * samples, must not leak into the coded reference sample */
+    uint32_t mask = UINT32_MAX >> (32 - strm->bits_per_sample);
+
     state->uncomp_len = (strm->block_size - 1) * strm->bits_per_sample;
+    state->ref = 1;
+
+    if (direct && state->native_in
+        && (uintptr_t)strm->next_in % sizeof(uint32_t) == 0) {
+        x = (uint32_t *)strm->next_in;
+        state->ref_sample = x[0] & mask;
+        d[0] = 0;
+        state->preprocess(state, x, d, rsi);
+        strm->next_in += len * sizeof(uint32_t);
+        strm->avail_in -= len * sizeof(uint32_t);
+        return;
+    }
+
+    if (direct)
+        state->get_samples(strm, x, 1);
+    else
+        x[0] = d[0];
+
+    state->ref_sample = x[0] & mask;
+    d[0] = 0;
+
+    for (s = 0; s < rsi; s += n) {
+        n = MIN(PP_STRIP, rsi - s);
+        if (direct)
+            state->get_samples(strm, x + 1, n);
+        else
+            memcpy(x + 1, d + s + 1, n * sizeof(uint32_t));
+        state->preprocess(state, x, d + s, n);
+        x[0] = x[n];
+    }
 }
 
-static inline uint64_t block_fs(struct aec_stream *strm, int k)
+static inline uint64_t block_fs(struct aec_stream *strm, uint32_t bs,
+                                int k)
 {
     /**
        Sum FS of all samples in block for given splitting position.
@@ -320,13 +386,14 @@ static inline uint64_t block_fs(struct aec_stream *strm, int k)
     uint64_t fs = 0;
     struct internal_state *state = strm->state;
 
-    for (i = 0; i < strm->block_size; i++)
+    for (i = 0; i < bs; i++)
         fs += (uint64_t)(state->block[i] >> k);
 
     return fs;
 }
 
-static uint32_t assess_splitting_option(struct aec_stream *strm)
+static inline uint32_t assess_splitting_option(struct aec_stream *strm,
+                                               uint32_t bs)
 {
     /**
        Length of CDS encoded with splitting option and optimal k.
@@ -351,6 +418,10 @@ static uint32_t assess_splitting_option(struct aec_stream *strm)
        larger binary part. So we know that the CDS for k+1 will be
        larger than for k without actually computing the length. An
        analogue check can be done for decreasing k.
+
+       If a vectorized block_fs kernel is available, FS lengths are
+       computed for FS_WINDOW neighbouring k in one pass over the
+       block so most evaluations are served from fs_win.
      */
 
     int k;
@@ -361,17 +432,30 @@ static uint32_t assess_splitting_option(struct aec_stream *strm)
     uint64_t len; /* CDS length for current k */
     uint64_t len_min; /* CDS length minimum so far */
     uint64_t fs_len; /* Length of FS part (not including 1s) */
+    uint64_t fs_win[FS_WINDOW]; /* FS lengths for k_win, k_win + 1, ... */
+    int k_win;
 
     struct internal_state *state = strm->state;
 
-    this_bs = strm->block_size - state->ref;
+    this_bs = bs - state->ref;
     len_min = UINT64_MAX;
     k = k_min = state->k;
     no_turn = k == 0;
     dir = 1;
+    k_win = MAX(k - 1, 0);
+    if (state->block_fs)
+        state->block_fs(state->block, bs, k_win, fs_win);
 
     for (;;) {
-        fs_len = block_fs(strm, k);
+        if (state->block_fs == NULL) {
+            fs_len = block_fs(strm, bs, k);
+        } else {
+            if (k < k_win || k >= k_win + FS_WINDOW) {
+                k_win = dir? k: MAX(k - FS_WINDOW + 1, 0);
+                state->block_fs(state->block, bs, k_win, fs_win);
+            }
+            fs_len = fs_win[k - k_win];
+        }
         len = fs_len + this_bs * (k + 1);
 
         if (len < len_min) {
@@ -409,7 +493,8 @@ static uint32_t assess_splitting_option(struct aec_stream *strm)
     return (uint32_t)len_min;
 }
 
-static uint32_t assess_se_option(struct aec_stream *strm)
+static inline uint32_t assess_se_option(struct aec_stream *strm,
+                                        uint32_t bs)
 {
     /**
        Length of CDS encoded with Second Extension option.
@@ -424,7 +509,7 @@ static uint32_t assess_se_option(struct aec_stream *strm)
 
     len = 1;
 
-    for (i = 0; i < strm->block_size; i += 2) {
+    for (i = 0; i < bs; i += 2) {
         d = (uint64_t)block[i] + (uint64_t)block[i + 1];
         len += d * (d + 1) / 2 + block[i + 1] + 1;
         if (len > state->uncomp_len)
@@ -433,6 +518,17 @@ static uint32_t assess_se_option(struct aec_stream *strm)
     return (uint32_t)len;
 }
 
+static inline size_t cds_bits(const struct internal_state *state,
+                              const uint8_t *cds, int bits)
+{
+    /**
+       Number of bits emitted since the output position given by cds
+       and the free bits in *cds.
+    */
+
+    return (size_t)(state->cds - cds) * 8 + bits - state->bits;
+}
+
 static void init_output(struct aec_stream *strm)
 {
     /**
@@ -496,13 +592,11 @@ static int m_flush_block(struct aec_stream *strm)
     int n;
     struct internal_state *state = strm->state;
 
-#ifdef ENABLE_RSI_PADDING
     if (state->blocks_avail == 0
         && strm->flags & AEC_PAD_RSI
         && state->block_nonzero == 0
         )
         emit(state, 0, state->bits % 8);
-#endif
 
     if (state->direct_out) {
         n = (int)(state->cds - strm->next_out);
@@ -517,144 +611,227 @@ static int m_flush_block(struct aec_stream *strm)
     return M_CONTINUE;
 }
 
-static int m_encode_splitting(struct aec_stream *strm)
-{
-    struct internal_state *state = strm->state;
-    int k = state->k;
-
-    emit(state, k + 1, state->id_len);
-    if (state->ref)
-        emit(state, state->ref_sample, strm->bits_per_sample);
-
-    emitblock_fs(strm, k, state->ref);
-    if (k)
-        emitblock(strm, k, state->ref);
-
-    return m_flush_block(strm);
-}
-
-static int m_encode_uncomp(struct aec_stream *strm)
-{
-    struct internal_state *state = strm->state;
-
-    emit(state, (1U << state->id_len) - 1, state->id_len);
-    if (state->ref)
-        state->block[0] = state->ref_sample;
-    emitblock(strm, strm->bits_per_sample, 0);
-    return m_flush_block(strm);
-}
-
-static int m_encode_se(struct aec_stream *strm)
-{
-    size_t i;
-    uint32_t d;
-    struct internal_state *state = strm->state;
-
-    emit(state, 1, state->id_len + 1);
-    if (state->ref)
-        emit(state, state->ref_sample, strm->bits_per_sample);
-
-    for (i = 0; i < strm->block_size; i+= 2) {
-        d = state->block[i] + state->block[i + 1];
-        emitfs(state, d * (d + 1) / 2 + state->block[i + 1]);
-    }
-
-    return m_flush_block(strm);
-}
-
 static int m_encode_zero(struct aec_stream *strm)
 {
     struct internal_state *state = strm->state;
+    uint8_t *cds = state->cds;
+    int bits = state->bits;
 
     emit(state, 0, state->id_len + 1);
 
     if (state->zero_ref)
         emit(state, state->zero_ref_sample, strm->bits_per_sample);
 
-    if (state->zero_blocks == ROS)
+    /* A run which is not ended by a nonzero block reaches the end of
+     * a segment or RSI. If it is longer than four blocks, it is coded
+     * as Remainder Of Segment. */
+    if (state->block_nonzero == 0 && state->zero_blocks > 4)
         emitfs(state, 4);
     else if (state->zero_blocks >= 5)
         emitfs(state, state->zero_blocks);
     else
         emitfs(state, state->zero_blocks - 1);
 
+    if (state->stats)
+        stats_add(state->stats, STATS_ZERO, state->zero_blocks,
+                  cds_bits(state, cds, bits));
     state->zero_blocks = 0;
     return m_flush_block(strm);
 }
 
-static int m_select_code_option(struct aec_stream *strm)
+/* Generate the block level states of the encoder for block size BS
+ * and BPS bits per sample. With constants the compiler can fully
+ * unroll and vectorize the loops over a block. */
+#define ENCODE_BLOCK(NAME, BS, BPS)                                      \
+    static int m_encode_splitting_##NAME(struct aec_stream *strm)        \
+    {                                                                    \
+        struct internal_state *state = strm->state;                      \
+        int k = state->k;                                                \
+        uint8_t *cds = state->cds;                                       \
+        int bits = state->bits;                                          \
+                                                                         \
+        emit(state, k + 1, state->id_len);                               \
+        if (state->ref)                                                  \
+            emit(state, state->ref_sample, BPS);                         \
+                                                                         \
+        emitblock_fs(strm, BS, k, state->ref);                           \
+        if (k)                                                           \
+            emitblock(strm, BS, k, state->ref);                          \
+                                                                         \
+        if (state->stats)                                                \
+            stats_add(state->stats, k, 1, cds_bits(state, cds, bits));   \
+        return m_flush_block(strm);                                      \
+    }                                                                    \
+                                                                         \
+    static int m_encode_uncomp_##NAME(struct aec_stream *strm)           \
+    {                                                                    \
+        struct internal_state *state = strm->state;                      \
+        uint8_t *cds = state->cds;                                       \
+        int bits = state->bits;                                          \
+                                                                         \
+        emit(state, (1U << state->id_len) - 1, state->id_len);           \
+        if (state->ref)                                                  \
+            state->block[0] = state->ref_sample;                         \
+        emitblock(strm, BS, BPS, 0);                                     \
+        if (state->stats)                                                \
+            stats_add(state->stats, STATS_UNCOMP, 1,                     \
+                      cds_bits(state, cds, bits));                       \
+        return m_flush_block(strm);                                      \
+    }                                                                    \
+                                                                         \
+    static int m_encode_se_##NAME(struct aec_stream *strm)               \
+    {                                                                    \
+        size_t i;                                                        \
+        uint32_t d;                                                      \
+        struct internal_state *state = strm->state;                      \
+        uint8_t *cds = state->cds;                                       \
+        int bits = state->bits;                                          \
+                                                                         \
+        emit(state, 1, state->id_len + 1);                               \
+        if (state->ref)                                                  \
+            emit(state, state->ref_sample, BPS);                         \
+                                                                         \
+        for (i = 0; i < BS; i+= 2) {                                     \
+            d = state->block[i] + state->block[i + 1];                   \
+            emitfs(state, d * (d + 1) / 2 + state->block[i + 1]);        \
+        }                                                                \
+                                                                         \
+        if (state->stats)                                                \
+            stats_add(state->stats, STATS_SE, 1,                         \
+                      cds_bits(state, cds, bits));                       \
+        return m_flush_block(strm);                                      \
+    }                                                                    \
+                                                                         \
+    static int m_select_code_option_##NAME(struct aec_stream *strm)      \
+    {                                                                    \
+        /**                                                              \
+           Decide which code option to use.                              \
+        */                                                               \
+                                                                         \
+        uint32_t split_len;                                              \
+        uint32_t se_len;                                                 \
+        struct internal_state *state = strm->state;                      \
+                                                                         \
+        if (state->id_len > 1)                                           \
+            split_len = assess_splitting_option(strm, BS);               \
+        else                                                             \
+            split_len = UINT32_MAX;                                      \
+        se_len = assess_se_option(strm, BS);                             \
+                                                                         \
+        if (split_len < state->uncomp_len) {                             \
+            if (split_len < se_len)                                      \
+                return m_encode_splitting_##NAME(strm);                  \
+            else                                                         \
+                return m_encode_se_##NAME(strm);                         \
+        } else {                                                         \
+            if (state->uncomp_len <= se_len)                             \
+                return m_encode_uncomp_##NAME(strm);                     \
+            else                                                         \
+                return m_encode_se_##NAME(strm);                         \
+        }                                                                \
+    }                                                                    \
+                                                                         \
+    static int m_check_zero_block_##NAME(struct aec_stream *strm)        \
+    {                                                                    \
+        /**                                                              \
+           Check if input block is all zero.                             \
+                                                                         \
+           Aggregate consecutive zero blocks until we find !0 or reach   \
+           the end of a segment or RSI.                                  \
+        */                                                               \
+                                                                         \
+        size_t i;                                                        \
+        struct internal_state *state = strm->state;                      \
+        uint32_t *p = state->block;                                      \
+                                                                         \
+        for (i = 0; i < BS; i++)                                         \
+            if (p[i] != 0)                                               \
+                break;                                                   \
+                                                                         \
+        if (i < BS) {                                                    \
+            if (state->zero_blocks) {                                    \
+                /* The current block isn't zero but we have to emit a    \
+                 * previous zero block first. The current block will be  \
+                 * flagged and handled later.                            \
+                 */                                                      \
+                state->block_nonzero = 1;                                \
+                state->mode = m_encode_zero;                             \
+                return M_CONTINUE;                                       \
+            }                                                            \
+            state->mode = m_select_code_option_##NAME;                   \
+            return M_CONTINUE;                                           \
+        } else {                                                         \
+            state->zero_blocks++;                                        \
+            if (state->zero_blocks == 1) {                               \
+                state->zero_ref = state->ref;                            \
+                state->zero_ref_sample = state->ref_sample;              \
+            }                                                            \
+            if (state->blocks_avail == 0                                 \
+                || state->blocks_dispensed % 64 == 0) {                  \
+                state->mode = m_encode_zero;                             \
+                return M_CONTINUE;                                       \
+            }                                                            \
+            state->mode = m_get_block;                                   \
+            return M_CONTINUE;                                           \
+        }                                                                \
+    }
+
+ENCODE_BLOCK(generic, strm->block_size, strm->bits_per_sample)
+ENCODE_BLOCK(8_8, 8, 8)
+ENCODE_BLOCK(16_8, 16, 8)
+ENCODE_BLOCK(16_16, 16, 16)
+ENCODE_BLOCK(32_8, 32, 8)
+ENCODE_BLOCK(32_16, 32, 16)
+ENCODE_BLOCK(32_32, 32, 32)
+ENCODE_BLOCK(64_16, 64, 16)
+
+static void select_block_states(struct aec_stream *strm)
 {
     /**
-       Decide which code option to use.
+       Use specialized block states for common configurations.
     */
 
-    uint32_t split_len;
-    uint32_t se_len;
     struct internal_state *state = strm->state;
 
-    if (state->id_len > 1)
-        split_len = assess_splitting_option(strm);
-    else
-        split_len = UINT32_MAX;
-    se_len = assess_se_option(strm);
-
-    if (split_len < state->uncomp_len) {
-        if (split_len < se_len)
-            return m_encode_splitting(strm);
-        else
-            return m_encode_se(strm);
-    } else {
-        if (state->uncomp_len <= se_len)
-            return m_encode_uncomp(strm);
-        else
-            return m_encode_se(strm);
+#define SELECT_BLOCK(NAME, BS, BPS)                                      \
+    if (strm->block_size == BS && strm->bits_per_sample == BPS) {        \
+        state->check_zero_block = m_check_zero_block_##NAME;             \
+        state->select_code_option = m_select_code_option_##NAME;         \
+        return;                                                          \
     }
+
+    SELECT_BLOCK(8_8, 8, 8)
+    SELECT_BLOCK(16_8, 16, 8)
+    SELECT_BLOCK(16_16, 16, 16)
+    SELECT_BLOCK(32_8, 32, 8)
+    SELECT_BLOCK(32_16, 32, 16)
+    SELECT_BLOCK(32_32, 32, 32)
+    SELECT_BLOCK(64_16, 64, 16)
+#undef SELECT_BLOCK
+
+    state->check_zero_block = m_check_zero_block_generic;
+    state->select_code_option = m_select_code_option_generic;
 }
 
-static int m_check_zero_block(struct aec_stream *strm)
+static void push_rsi_offset(struct aec_stream *strm)
 {
     /**
-       Check if input block is all zero.
+       Record bit offset of the RSI about to be encoded.
 
-       Aggregate consecutive zero blocks until we find !0 or reach the
-       end of a segment or RSI.
-    */
+       All complete bytes have been handed to the user at this point
+       and the current byte has 8 - bits bits in use.
+     */
 
-    size_t i;
     struct internal_state *state = strm->state;
-    uint32_t *p = state->block;
+    size_t offset;
 
-    for (i = 0; i < strm->block_size; i++)
-        if (p[i] != 0)
-            break;
+    if (state->offsets == NULL)
+        return;
 
-    if (i < strm->block_size) {
-        if (state->zero_blocks) {
-            /* The current block isn't zero but we have to emit a
-             * previous zero block first. The current block will be
-             * flagged and handled later.
-             */
-            state->block_nonzero = 1;
-            state->mode = m_encode_zero;
-            return M_CONTINUE;
-        }
-        state->mode = m_select_code_option;
-        return M_CONTINUE;
-    } else {
-        state->zero_blocks++;
-        if (state->zero_blocks == 1) {
-            state->zero_ref = state->ref;
-            state->zero_ref_sample = state->ref_sample;
-        }
-        if (state->blocks_avail == 0 || state->blocks_dispensed % 64 == 0) {
-            if (state->zero_blocks > 4)
-                state->zero_blocks = ROS;
-
-            state->mode = m_encode_zero;
-            return M_CONTINUE;
-        }
-        state->mode = m_get_block;
-        return M_CONTINUE;
+    offset = (strm->total_out - strm->avail_out) * 8 + (8 - state->bits);
+    if (vector_push_back(&state->alloc, state->offsets, offset)) {
+        vector_destroy(&state->alloc, state->offsets);
+        state->offsets = NULL;
     }
 }
 
@@ -664,27 +841,32 @@ static int m_get_rsi_resumable(struct aec_stream *strm)
        Get RSI while input buffer is short.
 
        Let user provide more input. Once we got all input pad buffer
-       to full RSI.
+       to full block.
     */
 
     struct internal_state *state = strm->state;
 
     do {
         if (strm->avail_in >= state->bytes_per_sample) {
-            state->data_raw[state->i] = state->get_sample(strm);
+            state->data_pp[state->i] = state->get_sample(strm);
         } else {
             if (state->flush == AEC_FLUSH) {
                 if (state->i > 0) {
                     state->blocks_avail = state->i / strm->block_size - 1;
                     if (state->i % strm->block_size)
                         state->blocks_avail++;
-                    do
-                        state->data_raw[state->i] =
-                            state->data_raw[state->i - 1];
-                    while(++state->i < strm->rsi * strm->block_size);
+                    while (state->i % strm->block_size) {
+                        state->data_pp[state->i] =
+                            state->data_pp[state->i - 1];
+                        state->i++;
+                    }
+                    break;
                 } else {
                     /* Finish encoding by padding the last byte with
-                     * zero bits. */
+                     * zero bits. Further calls after that emit
+                     * nothing. */
+                    if (state->flushed)
+                        return M_EXIT;
                     emit(state, 0, state->bits);
                     if (strm->avail_out > 0) {
                         if (!state->direct_out)
@@ -700,10 +882,44 @@ static int m_get_rsi_resumable(struct aec_stream *strm)
         }
     } while (++state->i < strm->rsi * strm->block_size);
 
+    push_rsi_offset(strm);
     if (strm->flags & AEC_DATA_PREPROCESS)
-        state->preprocess(strm);
+        preprocess_rsi(strm, (state->blocks_avail + 1)
+                       * strm->block_size, 0);
 
-    return m_check_zero_block(strm);
+    return state->check_zero_block(strm);
+}
+
+static int get_line(struct aec_stream *strm)
+{
+    /**
+       Fill an RSI with one line of input and pad the rest.
+
+       Padding repeats the last sample of the line with preprocessing
+       and is zero otherwise. Repeated samples are mapped to zero, so
+       in both cases the padding is zero in data_pp. The last line
+       may be short.
+    */
+
+    struct internal_state *state = strm->state;
+    size_t rsi_samples = strm->rsi * strm->block_size;
+    size_t n = MIN(state->line_len, strm->avail_in / state->bytes_per_sample);
+
+    push_rsi_offset(strm);
+    if (n == rsi_samples && state->direct_in
+        && (uintptr_t)strm->next_in % sizeof(uint32_t) == 0) {
+        state->block = (uint32_t *)strm->next_in;
+        strm->next_in += state->rsi_len;
+        strm->avail_in -= state->rsi_len;
+        return state->check_zero_block(strm);
+    }
+
+    if (strm->flags & AEC_DATA_PREPROCESS)
+        preprocess_rsi(strm, n, 1);
+    else
+        state->get_samples(strm, state->data_pp, n);
+    memset(state->data_pp + n, 0, (rsi_samples - n) * sizeof(uint32_t));
+    return state->check_zero_block(strm);
 }
 
 static int m_get_block(struct aec_stream *strm)
@@ -721,7 +937,7 @@ static int m_get_block(struct aec_stream *strm)
 
     if (state->block_nonzero) {
         state->block_nonzero = 0;
-        state->mode = m_select_code_option;
+        state->mode = state->select_code_option;
         return M_CONTINUE;
     }
 
@@ -730,14 +946,39 @@ static int m_get_block(struct aec_stream *strm)
         state->block = state->data_pp;
         state->blocks_dispensed = 1;
 
-        if (strm->avail_in >= state->rsi_len) {
-            state->get_rsi(strm);
-            if (strm->flags & AEC_DATA_PREPROCESS)
-                state->preprocess(strm);
+        /* Padded RSIs are self-contained so that they can be encoded
+         * independently of each other. */
+        if (strm->flags & AEC_PAD_RSI)
+            state->k = 0;
+
+        if (state->line_len && strm->avail_in >= state->bytes_per_sample)
+            return get_line(strm);
+
+        if (state->line_len == 0 && strm->avail_in >= state->rsi_len) {
+            push_rsi_offset(strm);
+            if (state->direct_in
+                && (uintptr_t)strm->next_in % sizeof(uint32_t) == 0) {
+                /* Without preprocessing blocks are only read, so
+                 * they can be coded in place. */
+                state->block = (uint32_t *)strm->next_in;
+                strm->next_in += state->rsi_len;
+                strm->avail_in -= state->rsi_len;
+            } else if (strm->flags & AEC_DATA_PREPROCESS) {
+                preprocess_rsi(strm, strm->rsi * strm->block_size, 1);
+            } else {
+                state->get_samples(strm, state->data_pp,
+                                   strm->rsi * strm->block_size);
+            }
 
-            return m_check_zero_block(strm);
+            return state->check_zero_block(strm);
         } else {
             state->i = 0;
+            if (state->flush == AEC_FLUSH && state->line_len == 0) {
+                /* The final short RSI is complete, convert all of it
+                 * at once and let the resumable state pad it. */
+                state->i = strm->avail_in / state->bytes_per_sample;
+                state->get_samples(strm, state->data_pp, state->i);
+            }
             state->mode = m_get_rsi_resumable;
         }
     } else {
@@ -748,7 +989,7 @@ static int m_get_block(struct aec_stream *strm)
         state->block += strm->block_size;
         state->blocks_dispensed++;
         state->blocks_avail--;
-        return m_check_zero_block(strm);
+        return state->check_zero_block(strm);
     }
     return M_CONTINUE;
 }
@@ -756,12 +997,48 @@ static int m_get_block(struct aec_stream *strm)
 static void cleanup(struct aec_stream *strm)
 {
     struct internal_state *state = strm->state;
+    struct aec_allocator alloc = state->alloc;
 
-    if (strm->flags & AEC_DATA_PREPROCESS && state->data_raw)
-        free(state->data_raw);
-    if (state->data_pp)
-        free(state->data_pp);
-    free(state);
+    aec_free(&alloc, state->data_pp);
+    vector_destroy(&alloc, state->offsets);
+    stats_destroy(&alloc, state->stats);
+    aec_free(&alloc, state);
+    strm->state = NULL;
+}
+
+static void reset_stream(struct aec_stream *strm)
+{
+    /**
+       Set up the state for the start of a new stream.
+    */
+
+    struct internal_state *state = strm->state;
+
+    state->i = 0;
+    state->blocks_avail = 0;
+    state->blocks_dispensed = 0;
+    state->block = state->data_pp;
+    state->direct_out = 0;
+    state->direct_in = 0;
+    state->ref = 0;
+    state->zero_ref = 0;
+    state->zero_blocks = 0;
+    state->block_nonzero = 0;
+    state->k = 0;
+    state->flush = AEC_NO_FLUSH;
+    state->flushed = 0;
+    state->line_len = 0;
+    state->uncomp_len = strm->block_size * strm->bits_per_sample;
+    vector_clear(state->offsets);
+    stats_clear(state->stats);
+
+    strm->total_in = 0;
+    strm->total_out = 0;
+
+    state->cds = state->cds_buf;
+    *state->cds = 0;
+    state->bits = 8;
+    state->mode = m_get_block;
 }
 
 /*
@@ -770,9 +1047,11 @@ static void cleanup(struct aec_stream *strm)
  *
  */
 
-int aec_encode_init(struct aec_stream *strm)
+static int check_config(const struct aec_stream *strm)
 {
-    struct internal_state *state;
+    /**
+       Check the parameters of strm before any state is set up.
+    */
 
     if (strm->bits_per_sample > 32 || strm->bits_per_sample == 0)
         return AEC_CONF_ERROR;
@@ -793,11 +1072,47 @@ int aec_encode_init(struct aec_stream *strm)
     if (strm->rsi > 4096)
         return AEC_CONF_ERROR;
 
-    state = malloc(sizeof(struct internal_state));
+    /* The restricted set of options is defined up to 4 bit */
+    if (strm->flags & AEC_RESTRICTED && strm->bits_per_sample <= 8
+        && strm->bits_per_sample > 4)
+        return AEC_CONF_ERROR;
+
+    return AEC_OK;
+}
+
+static uint32_t sample_bytes(const struct aec_stream *strm)
+{
+    /**
+       Storage size of one input sample in bytes.
+    */
+
+    if (strm->bits_per_sample > 16) {
+        if (strm->bits_per_sample <= 24 && strm->flags & AEC_DATA_3BYTE)
+            return 3;
+        return 4;
+    }
+    if (strm->bits_per_sample > 8)
+        return 2;
+    return 1;
+}
+
+int aec_encode_init(struct aec_stream *strm)
+{
+    struct internal_state *state;
+    struct aec_allocator alloc;
+    int status;
+
+    status = check_config(strm);
+    if (status != AEC_OK)
+        return status;
+
+    aec_allocator_init(&alloc, strm);
+    state = aec_alloc(&alloc, sizeof(struct internal_state));
     if (state == NULL)
         return AEC_MEM_ERROR;
 
     memset(state, 0, sizeof(struct internal_state));
+    state->alloc = alloc;
     strm->state = state;
     state->uncomp_len = strm->block_size * strm->bits_per_sample;
 
@@ -810,19 +1125,24 @@ int aec_encode_init(struct aec_stream *strm)
             state->bytes_per_sample = 3;
             if (strm->flags & AEC_DATA_MSB) {
                 state->get_sample = aec_get_msb_24;
-                state->get_rsi = aec_get_rsi_msb_24;
+                state->get_samples = aec_get_samples_msb_24;
             } else {
                 state->get_sample = aec_get_lsb_24;
-                state->get_rsi = aec_get_rsi_lsb_24;
+                state->get_samples = aec_get_samples_lsb_24;
             }
         } else {
             state->bytes_per_sample = 4;
+#ifdef WORDS_BIGENDIAN
+            state->native_in = (strm->flags & AEC_DATA_MSB) != 0;
+#else
+            state->native_in = (strm->flags & AEC_DATA_MSB) == 0;
+#endif
             if (strm->flags & AEC_DATA_MSB) {
                 state->get_sample = aec_get_msb_32;
-                state->get_rsi = aec_get_rsi_msb_32;
+                state->get_samples = aec_get_samples_msb_32;
             } else {
                 state->get_sample = aec_get_lsb_32;
-                state->get_rsi = aec_get_rsi_lsb_32;
+                state->get_samples = aec_get_samples_lsb_32;
             }
         }
     }
@@ -833,76 +1153,90 @@ int aec_encode_init(struct aec_stream *strm)
 
         if (strm->flags & AEC_DATA_MSB) {
             state->get_sample = aec_get_msb_16;
-            state->get_rsi = aec_get_rsi_msb_16;
+            state->get_samples = aec_get_samples_msb_16;
         } else {
             state->get_sample = aec_get_lsb_16;
-            state->get_rsi = aec_get_rsi_lsb_16;
+            state->get_samples = aec_get_samples_lsb_16;
         }
     } else {
         /* 8 bit settings */
         if (strm->flags & AEC_RESTRICTED) {
-            if (strm->bits_per_sample <= 4) {
-                if (strm->bits_per_sample <= 2)
-                    state->id_len = 1;
-                else
-                    state->id_len = 2;
-            } else {
-                return AEC_CONF_ERROR;
-            }
+            if (strm->bits_per_sample <= 2)
+                state->id_len = 1;
+            else
+                state->id_len = 2;
         } else {
             state->id_len = 3;
         }
         state->bytes_per_sample = 1;
 
         state->get_sample = aec_get_8;
-        state->get_rsi = aec_get_rsi_8;
+        state->get_samples = aec_get_samples_8;
     }
     state->rsi_len = strm->rsi * strm->block_size * state->bytes_per_sample;
 
     if (strm->flags & AEC_DATA_SIGNED) {
-        state->xmax = UINT32_MAX >> (32 - strm->bits_per_sample + 1);
+        state->xmax = (UINT32_C(1) << (strm->bits_per_sample - 1)) - 1;
         state->xmin = ~state->xmax;
         state->preprocess = preprocess_signed;
+        state->preprocess_kernel = aec_select_preprocess(1);
     } else {
         state->xmin = 0;
         state->xmax = UINT32_MAX >> (32 - strm->bits_per_sample);
         state->preprocess = preprocess_unsigned;
+        state->preprocess_kernel = aec_select_preprocess(0);
     }
 
     state->kmax = (1U << state->id_len) - 3;
+    state->block_fs = aec_select_block_fs(strm->block_size);
+    select_block_states(strm);
 
-    state->data_pp = malloc(strm->rsi
-                            * strm->block_size
-                            * sizeof(uint32_t));
+    state->data_pp = aec_alloc(&alloc, strm->rsi
+                               * strm->block_size
+                               * sizeof(uint32_t));
     if (state->data_pp == NULL) {
         cleanup(strm);
         return AEC_MEM_ERROR;
     }
 
-    if (strm->flags & AEC_DATA_PREPROCESS) {
-        state->data_raw = malloc(strm->rsi
-                                 * strm->block_size
-                                 * sizeof(uint32_t));
-        if (state->data_raw == NULL) {
-            cleanup(strm);
-            return AEC_MEM_ERROR;
-        }
-    } else {
-        state->data_raw = state->data_pp;
-    }
+    state->bits_per_sample = strm->bits_per_sample;
+    state->block_size = strm->block_size;
+    state->rsi = strm->rsi;
+    state->flags = strm->flags;
 
-    state->block = state->data_pp;
+    reset_stream(strm);
+    return AEC_OK;
+}
 
-    state->ref = 0;
-    strm->total_in = 0;
-    strm->total_out = 0;
-    state->flushed = 0;
+int aec_encode_reset(struct aec_stream *strm)
+{
+    /**
+       Prepare an initialized encoder for a new stream.
 
-    state->cds = state->cds_buf;
-    *state->cds = 0;
-    state->bits = 8;
-    state->mode = m_get_block;
+       Buffers are kept if the parameters did not change, otherwise
+       the state is set up from scratch.
+       The new parameters are checked first, so that a reset with
+       invalid parameters keeps the encoder as it was.
+    */
+
+    struct internal_state *state = strm->state;
+    int status;
 
+    if (state == NULL)
+        return AEC_STREAM_ERROR;
+
+    if (strm->bits_per_sample != state->bits_per_sample
+        || strm->block_size != state->block_size
+        || strm->rsi != state->rsi
+        || strm->flags != state->flags) {
+        status = check_config(strm);
+        if (status != AEC_OK)
+            return status;
+        cleanup(strm);
+        return aec_encode_init(strm);
+    }
+
+    reset_stream(strm);
     return AEC_OK;
 }
 
@@ -940,6 +1274,9 @@ int aec_encode_end(struct aec_stream *strm)
     struct internal_state *state = strm->state;
     int status;
 
+    if (state == NULL)
+        return AEC_STREAM_ERROR;
+
     status = AEC_OK;
     if (state->flush == AEC_FLUSH && state->flushed == 0)
         status = AEC_STREAM_ERROR;
@@ -947,6 +1284,86 @@ int aec_encode_end(struct aec_stream *strm)
     return status;
 }
 
+int aec_encode_enable_offsets(struct aec_stream *strm)
+{
+    struct internal_state *state = strm->state;
+
+    if (state->offsets != NULL)
+        return AEC_OK;
+
+    state->offsets = vector_create(&state->alloc);
+    if (state->offsets == NULL)
+        return AEC_MEM_ERROR;
+    return AEC_OK;
+}
+
+int aec_encode_count_offsets(struct aec_stream *strm, size_t *count)
+{
+    struct internal_state *state = strm->state;
+
+    if (state->offsets == NULL)
+        return AEC_RSI_OFFSETS_ERROR;
+
+    *count = vector_size(state->offsets);
+    return AEC_OK;
+}
+
+int aec_encode_get_offsets(struct aec_stream *strm,
+                           size_t *offsets, size_t count)
+{
+    struct internal_state *state = strm->state;
+
+    if (state->offsets == NULL)
+        return AEC_RSI_OFFSETS_ERROR;
+
+    if (count < vector_size(state->offsets))
+        return AEC_MEM_ERROR;
+
+    memcpy(offsets, vector_data(state->offsets),
+           vector_size(state->offsets) * sizeof(size_t));
+    return AEC_OK;
+}
+
+int aec_encode_enable_stats(struct aec_stream *strm)
+{
+    struct internal_state *state = strm->state;
+
+    if (state->stats != NULL)
+        return AEC_OK;
+
+    state->stats = stats_create(&state->alloc);
+    if (state->stats == NULL)
+        return AEC_MEM_ERROR;
+    return AEC_OK;
+}
+
+int aec_encode_get_stats(struct aec_stream *strm, struct aec_stats *stats)
+{
+    struct internal_state *state = strm->state;
+
+    if (state->stats == NULL)
+        return AEC_CONF_ERROR;
+
+    *stats = *state->stats;
+    return AEC_OK;
+}
+
+static void enable_direct_in(struct aec_stream *strm)
+{
+    /**
+       Code RSIs directly from next_in if samples are stored as
+       native 32 bit integers and are not preprocessed.
+
+       This is only safe if the input stays untouched until encoding
+       has finished, as is the case for the buffer functions.
+     */
+
+    struct internal_state *state = strm->state;
+
+    state->direct_in = state->native_in
+        && (strm->flags & AEC_DATA_PREPROCESS) == 0;
+}
+
 int aec_buffer_encode(struct aec_stream *strm)
 {
     int status;
@@ -954,6 +1371,32 @@ int aec_buffer_encode(struct aec_stream *strm)
     status = aec_encode_init(strm);
     if (status != AEC_OK)
         return status;
+    enable_direct_in(strm);
+    status = aec_encode(strm, AEC_FLUSH);
+    if (status != AEC_OK) {
+        cleanup(strm);
+        return status;
+    }
+    return aec_encode_end(strm);
+}
+
+int aec_buffer_encode_lines(struct aec_stream *strm, size_t line_len)
+{
+    /**
+       Like aec_buffer_encode() but every RSI is filled with one line
+       of line_len samples from next_in and padded.
+    */
+
+    int status;
+
+    if (line_len == 0 || line_len > (size_t)strm->rsi * strm->block_size)
+        return AEC_CONF_ERROR;
+
+    status = aec_encode_init(strm);
+    if (status != AEC_OK)
+        return status;
+    enable_direct_in(strm);
+    strm->state->line_len = line_len;
     status = aec_encode(strm, AEC_FLUSH);
     if (status != AEC_OK) {
         cleanup(strm);
@@ -961,3 +1404,284 @@ int aec_buffer_encode(struct aec_stream *strm)
     }
     return aec_encode_end(strm);
 }
+
+int aec_buffer_encode_ctx(struct aec_stream *strm)
+{
+    /**
+       Like aec_buffer_encode() but with an initialized encoder which
+       is kept for further calls.
+    */
+
+    int status;
+
+    status = aec_encode_reset(strm);
+    if (status != AEC_OK)
+        return status;
+    enable_direct_in(strm);
+    status = aec_encode(strm, AEC_FLUSH);
+    if (status != AEC_OK)
+        return status;
+    if (strm->state->flushed == 0)
+        return AEC_STREAM_ERROR;
+    return AEC_OK;
+}
+
+struct encode_chunk {
+    struct aec_stream strm;
+
+    /* private output buffer */
+    unsigned char *out;
+
+    int status;
+};
+
+struct encode_chunks {
+    struct encode_chunk *chunk;
+    size_t nchunks;
+};
+
+static void encode_chunk(void *arg, size_t n)
+{
+    /**
+       Encode one chunk of whole RSIs into a private buffer.
+
+       Only the last chunk is flushed. All others end on an RSI
+       boundary where, thanks to RSI padding, the pending output byte
+       is complete and can be appended as is.
+     */
+
+    struct encode_chunks *chunks = arg;
+    struct aec_stream *strm = &chunks->chunk[n].strm;
+    int status;
+
+    status = aec_encode_init(strm);
+    if (status != AEC_OK) {
+        chunks->chunk[n].status = status;
+        return;
+    }
+    enable_direct_in(strm);
+
+    if (n == chunks->nchunks - 1) {
+        aec_encode(strm, AEC_FLUSH);
+    } else {
+        aec_encode(strm, AEC_NO_FLUSH);
+        if (strm->state->bits == 0 && strm->avail_out > 0) {
+            *strm->next_out++ = *strm->state->cds;
+            strm->avail_out--;
+            strm->total_out++;
+        }
+    }
+    chunks->chunk[n].status = aec_encode_end(strm);
+}
+
+static int buffer_encode_mt(struct aec_stream *strm, struct aec_pool *pool,
+                            int nthreads)
+{
+    /**
+       Encode a memory buffer with several threads.
+
+       Padded RSIs don't depend on each other, so the input is split
+       into chunks of whole RSIs which are encoded concurrently and
+       joined afterwards. The result is identical to that of
+       aec_buffer_encode().
+     */
+
+    struct encode_chunks chunks;
+    struct aec_allocator alloc;
+    struct encode_chunk *c;
+    size_t rsi_len, nrsi, rsi_per_chunk, out_len, total_out, i;
+    int status;
+
+    nthreads = aec_thread_count(pool, nthreads);
+    if (nthreads < 2 || (strm->flags & AEC_PAD_RSI) == 0)
+        return aec_buffer_encode(strm);
+
+    status = check_config(strm);
+    if (status != AEC_OK)
+        return status;
+    rsi_len = strm->rsi * strm->block_size * sample_bytes(strm);
+
+    nrsi = (strm->avail_in + rsi_len - 1) / rsi_len;
+    if (nrsi < 2)
+        return aec_buffer_encode(strm);
+
+    /* A few chunks per thread even out differences in coding
+     * speed. */
+    chunks.nchunks = MIN(nrsi, (size_t)nthreads * 4);
+    rsi_per_chunk = (nrsi + chunks.nchunks - 1) / chunks.nchunks;
+    chunks.nchunks = (nrsi + rsi_per_chunk - 1) / rsi_per_chunk;
+
+    /* Every block takes at most one bit more than the uncompressed
+     * option. Allow for RSI padding and room for direct output. */
+    out_len = rsi_per_chunk
+        * ((strm->rsi * (6 + strm->block_size * strm->bits_per_sample)
+            + 7) / 8 + 1)
+        + CDSLEN + 1;
+
+    aec_allocator_init(&alloc, strm);
+    chunks.chunk = aec_alloc(&alloc,
+                             chunks.nchunks * sizeof(struct encode_chunk));
+    if (chunks.chunk == NULL)
+        return AEC_MEM_ERROR;
+    memset(chunks.chunk, 0, chunks.nchunks * sizeof(struct encode_chunk));
+
+    status = AEC_OK;
+    for (i = 0; i < chunks.nchunks; i++) {
+        c = &chunks.chunk[i];
+        c->strm = *strm;
+        c->strm.next_in = strm->next_in + i * rsi_per_chunk * rsi_len;
+        if (i == chunks.nchunks - 1)
+            c->strm.avail_in = strm->avail_in - i * rsi_per_chunk * rsi_len;
+        else
+            c->strm.avail_in = rsi_per_chunk * rsi_len;
+        c->out = aec_alloc(&alloc, out_len);
+        if (c->out == NULL) {
+            status = AEC_MEM_ERROR;
+            goto CLEANUP;
+        }
+        c->strm.next_out = c->out;
+        c->strm.avail_out = out_len;
+    }
+
+    aec_parallel_for(pool, nthreads, chunks.nchunks, encode_chunk, &chunks);
+
+    total_out = 0;
+    for (i = 0; i < chunks.nchunks; i++) {
+        c = &chunks.chunk[i];
+        if (c->status != AEC_OK) {
+            status = c->status;
+            goto CLEANUP;
+        }
+        total_out += c->strm.total_out;
+    }
+
+    if (total_out > strm->avail_out) {
+        status = AEC_STREAM_ERROR;
+        goto CLEANUP;
+    }
+
+    strm->total_in = 0;
+    strm->total_out = 0;
+    for (i = 0; i < chunks.nchunks; i++) {
+        c = &chunks.chunk[i];
+        memcpy(strm->next_out, c->out, c->strm.total_out);
+        strm->next_out += c->strm.total_out;
+        strm->avail_out -= c->strm.total_out;
+        strm->total_out += c->strm.total_out;
+        strm->total_in += c->strm.total_in;
+    }
+    strm->next_in += strm->total_in;
+    strm->avail_in -= strm->total_in;
+
+CLEANUP:
+    for (i = 0; i < chunks.nchunks; i++)
+        aec_free(&alloc, chunks.chunk[i].out);
+    aec_free(&alloc, chunks.chunk);
+    return status;
+}
+
+int aec_buffer_encode_mt(struct aec_stream *strm, int nthreads)
+{
+    return buffer_encode_mt(strm, NULL, nthreads);
+}
+
+int aec_buffer_encode_pool(struct aec_stream *strm, struct aec_pool *pool)
+{
+    return buffer_encode_mt(strm, pool, 0);
+}
+
+struct encode_batch {
+    /* stream with shared parameters */
+    const struct aec_stream *strm;
+
+    struct aec_buffer *buffers;
+    size_t count;
+
+    /* buffers coded by one job */
+    size_t per_job;
+};
+
+static void encode_batch_job(void *arg, size_t n)
+{
+    /**
+       Code consecutive buffers of a batch with one stream which is
+       set up only once.
+     */
+
+    struct encode_batch *batch = arg;
+    struct aec_stream strm = *batch->strm;
+    struct aec_buffer *buf;
+    size_t i, end;
+    int status;
+
+    i = n * batch->per_job;
+    end = MIN(i + batch->per_job, batch->count);
+    status = aec_encode_init(&strm);
+    for (; i < end; i++) {
+        buf = &batch->buffers[i];
+        buf->total_out = 0;
+        buf->status = status;
+        if (status != AEC_OK)
+            continue;
+        strm.next_in = buf->next_in;
+        strm.avail_in = buf->avail_in;
+        strm.next_out = buf->next_out;
+        strm.avail_out = buf->avail_out;
+        buf->status = aec_buffer_encode_ctx(&strm);
+        if (buf->status == AEC_OK)
+            buf->total_out = strm.total_out;
+    }
+    if (status == AEC_OK)
+        aec_encode_end(&strm);
+}
+
+static int buffer_encode_batch(struct aec_stream *strm,
+                               struct aec_buffer *buffers, size_t count,
+                               struct aec_pool *pool, int nthreads)
+{
+    /**
+       Encode independent buffers with the parameters of strm.
+
+       Buffers are handed out in groups to up to nthreads threads.
+       Every group is coded with one stream, so the state is set up
+       once per group instead of once per buffer.
+     */
+
+    struct encode_batch batch;
+    size_t njobs, i;
+
+    if (count == 0)
+        return AEC_OK;
+
+    nthreads = aec_thread_count(pool, nthreads);
+
+    /* A few groups per thread even out differences in coding
+     * speed. */
+    njobs = nthreads < 2 ? 1 : MIN(count, (size_t)nthreads * 4);
+    batch.strm = strm;
+    batch.buffers = buffers;
+    batch.count = count;
+    batch.per_job = (count + njobs - 1) / njobs;
+    njobs = (count + batch.per_job - 1) / batch.per_job;
+
+    aec_parallel_for(pool, nthreads, njobs, encode_batch_job, &batch);
+
+    for (i = 0; i < count; i++)
+        if (buffers[i].status != AEC_OK)
+            return buffers[i].status;
+    return AEC_OK;
+}
+
+int aec_buffer_encode_batch(struct aec_stream *strm,
+                            struct aec_buffer *buffers, size_t count,
+                            int nthreads)
+{
+    return buffer_encode_batch(strm, buffers, count, NULL, nthreads);
+}
+
+int aec_buffer_encode_batch_pool(struct aec_stream *strm,
+                                 struct aec_buffer *buffers, size_t count,
+                                 struct aec_pool *pool)
+{
+    return buffer_encode_batch(strm, buffers, count, pool, 0);
+}
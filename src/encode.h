@@ -52,29 +52,47 @@
 #define ENCODE_H 1
 
 #include <config.h>
+#include <stddef.h>
 
 #if HAVE_STDINT_H
 #  include <stdint.h>
 #endif
 
+#include "alloc.h"
+
 #define M_CONTINUE 1
 #define M_EXIT 0
 #define MIN(a, b) (((a) < (b))? (a): (b))
+#define MAX(a, b) (((a) > (b))? (a): (b))
 
 /* Maximum CDS length in bytes: 5 bits ID, 64 * 32 bits samples, 7
  * bits carry from previous CDS */
 #define CDSLEN ((5 + 64 * 32 + 7 + 7) / 8)
 
-/* Marker for Remainder Of Segment condition in zero block encoding */
-#define ROS -1
+/* Number of samples converted and preprocessed in one pass */
+#define PP_STRIP 128
 
 struct aec_stream;
 
 struct internal_state {
     int (*mode)(struct aec_stream *);
     uint32_t (*get_sample)(struct aec_stream *);
-    void (*get_rsi)(struct aec_stream *);
-    void (*preprocess)(struct aec_stream *);
+    void (*get_samples)(struct aec_stream *, uint32_t *, size_t);
+    void (*preprocess)(struct internal_state *, const uint32_t *,
+                       uint32_t *, size_t);
+
+    /* block states specialized for block size and sample size */
+    int (*check_zero_block)(struct aec_stream *);
+    int (*select_code_option)(struct aec_stream *);
+
+    /* vectorized part of preprocess or NULL */
+    size_t (*preprocess_kernel)(const uint32_t *x, uint32_t *d, size_t n,
+                                uint32_t xmin, uint32_t xmax, uint32_t m);
+
+    /* FS lengths of a block for FS_WINDOW splitting positions or
+     * NULL if no vectorized kernel is used */
+    void (*block_fs)(const uint32_t *block, uint32_t block_size,
+                     int k, uint64_t *fs);
 
     /* bit length of code option identification key */
     int id_len;
@@ -90,8 +108,9 @@ struct internal_state {
     /* RSI blocks of preprocessed input */
     uint32_t *data_pp;
 
-    /* RSI blocks of input */
-    uint32_t *data_raw;
+    /* strip of input samples preceded by the last sample of the
+     * previous strip */
+    uint32_t pp_strip[PP_STRIP + 1];
 
     /* remaining blocks in buffer */
     int blocks_avail;
@@ -115,6 +134,12 @@ struct internal_state {
     /* cds points to strm->next_out (1) or cds_buf (0) */
     int direct_out;
 
+    /* samples are stored as native 32 bit integers (1) */
+    int native_in;
+
+    /* blocks are read from strm->next_in without copying (1) */
+    int direct_in;
+
     /* Free bits (LSB) in output buffer or accumulator */
     int bits;
 
@@ -155,6 +180,25 @@ struct internal_state {
 
     /* length of uncompressed CDS */
     uint32_t uncomp_len;
+
+    /* samples of input per RSI if input consists of padded lines,
+     * 0 otherwise */
+    size_t line_len;
+
+    /* allocation functions the state was set up with */
+    struct aec_allocator alloc;
+
+    /* parameters the state was set up for */
+    unsigned int bits_per_sample;
+    unsigned int block_size;
+    unsigned int rsi;
+    unsigned int flags;
+
+    /* bit offsets of RSIs in output stream or NULL if disabled */
+    struct vector_t *offsets;
+
+    /* code option statistics or NULL if disabled */
+    struct aec_stats *stats;
 };
 
 #endif /* ENCODE_H */
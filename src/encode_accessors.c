@@ -142,128 +142,121 @@ uint32_t aec_get_msb_32(struct aec_stream *strm)
     return data;
 }
 
-void aec_get_rsi_8(struct aec_stream *strm)
+void aec_get_samples_8(struct aec_stream *strm,
+                       uint32_t *restrict out, size_t n)
 {
-    int i;
-    uint32_t *restrict out = strm->state->data_raw;
+    size_t i;
     unsigned const char *restrict in = strm->next_in;
-    int rsi = strm->rsi * strm->block_size;
 
-    for (i = 0; i < rsi; i++)
+    for (i = 0; i < n; i++)
         out[i] = (uint32_t)in[i];
 
-    strm->next_in += rsi;
-    strm->avail_in -= rsi;
+    strm->next_in += n;
+    strm->avail_in -= n;
 }
 
-void aec_get_rsi_lsb_16(struct aec_stream *strm)
+void aec_get_samples_lsb_16(struct aec_stream *strm,
+                            uint32_t *restrict out, size_t n)
 {
-    int i;
-    uint32_t *restrict out = strm->state->data_raw;
+    size_t i;
     const unsigned char *restrict in = strm->next_in;
-    int rsi = strm->rsi * strm->block_size;
 
-    for (i = 0; i < rsi; i++)
+    for (i = 0; i < n; i++)
         out[i] = (uint32_t)in[2 * i] | ((uint32_t)in[2 * i + 1] << 8);
 
-    strm->next_in += 2 * rsi;
-    strm->avail_in -= 2 * rsi;
+    strm->next_in += 2 * n;
+    strm->avail_in -= 2 * n;
 }
 
-void aec_get_rsi_msb_16(struct aec_stream *strm)
+void aec_get_samples_msb_16(struct aec_stream *strm,
+                            uint32_t *restrict out, size_t n)
 {
-    int i;
-    uint32_t *restrict out = strm->state->data_raw;
+    size_t i;
     const unsigned char *restrict in = strm->next_in;
-    int rsi = strm->rsi * strm->block_size;
 
-    for (i = 0; i < rsi; i++)
+    for (i = 0; i < n; i++)
         out[i] = ((uint32_t)in[2 * i] << 8) | (uint32_t)in[2 * i + 1];
 
-    strm->next_in += 2 * rsi;
-    strm->avail_in -= 2 * rsi;
+    strm->next_in += 2 * n;
+    strm->avail_in -= 2 * n;
 }
 
-void aec_get_rsi_lsb_24(struct aec_stream *strm)
+void aec_get_samples_lsb_24(struct aec_stream *strm,
+                            uint32_t *restrict out, size_t n)
 {
-    int i;
-    uint32_t *restrict out = strm->state->data_raw;
+    size_t i;
     const unsigned char *restrict in = strm->next_in;
-    int rsi = strm->rsi * strm->block_size;
 
-    for (i = 0; i < rsi; i++)
+    for (i = 0; i < n; i++)
         out[i] = (uint32_t)in[3 * i]
             | ((uint32_t)in[3 * i + 1] << 8)
             | ((uint32_t)in[3 * i + 2] << 16);
 
-    strm->next_in += 3 * rsi;
-    strm->avail_in -= 3 * rsi;
+    strm->next_in += 3 * n;
+    strm->avail_in -= 3 * n;
 }
 
-void aec_get_rsi_msb_24(struct aec_stream *strm)
+void aec_get_samples_msb_24(struct aec_stream *strm,
+                            uint32_t *restrict out, size_t n)
 {
-    int i;
-    uint32_t *restrict out = strm->state->data_raw;
+    size_t i;
     const unsigned char *restrict in = strm->next_in;
-    int rsi = strm->rsi * strm->block_size;
 
-    for (i = 0; i < rsi; i++)
+    for (i = 0; i < n; i++)
         out[i] = ((uint32_t)in[3 * i] << 16)
             | ((uint32_t)in[3 * i + 1] << 8)
             | (uint32_t)in[3 * i + 2];
 
-    strm->next_in += 3 * rsi;
-    strm->avail_in -= 3 * rsi;
+    strm->next_in += 3 * n;
+    strm->avail_in -= 3 * n;
 }
 
-#define AEC_GET_RSI_NATIVE_32(BO)                       \
-    void aec_get_rsi_##BO##_32(struct aec_stream *strm) \
-    {                                               \
-        int rsi = strm->rsi * strm->block_size;     \
-        memcpy(strm->state->data_raw,               \
-               strm->next_in, 4 * rsi);             \
-        strm->next_in += 4 * rsi;                   \
-        strm->avail_in -= 4 * rsi;                  \
+#define AEC_GET_SAMPLES_NATIVE_32(BO)                           \
+    void aec_get_samples_##BO##_32(struct aec_stream *strm,     \
+                                   uint32_t *restrict out,      \
+                                   size_t n)                    \
+    {                                                           \
+        memcpy(out, strm->next_in, 4 * n);                      \
+        strm->next_in += 4 * n;                                 \
+        strm->avail_in -= 4 * n;                                \
     }
 
 #ifdef WORDS_BIGENDIAN
-void aec_get_rsi_lsb_32(struct aec_stream *strm)
+void aec_get_samples_lsb_32(struct aec_stream *strm,
+                            uint32_t *restrict out, size_t n)
 {
-    int i;
-    uint32_t *restrict out = strm->state->data_raw;
+    size_t i;
     const unsigned char *restrict in = strm->next_in;
-    int rsi = strm->rsi * strm->block_size;
 
-    for (i = 0; i < rsi; i++)
+    for (i = 0; i < n; i++)
         out[i] = (uint32_t)in[4 * i]
             | ((uint32_t)in[4 * i + 1] << 8)
             | ((uint32_t)in[4 * i + 2] << 16)
             | ((uint32_t)in[4 * i + 3] << 24);
 
-    strm->next_in += 4 * rsi;
-    strm->avail_in -= 4 * rsi;
+    strm->next_in += 4 * n;
+    strm->avail_in -= 4 * n;
 }
 
-AEC_GET_RSI_NATIVE_32(msb);
+AEC_GET_SAMPLES_NATIVE_32(msb);
 
 #else /* !WORDS_BIGENDIAN */
-void aec_get_rsi_msb_32(struct aec_stream *strm)
+void aec_get_samples_msb_32(struct aec_stream *strm,
+                            uint32_t *restrict out, size_t n)
 {
-    int i;
-    uint32_t *restrict out = strm->state->data_raw;
+    size_t i;
     const unsigned char *restrict in = strm->next_in;
-    int rsi = strm->rsi * strm->block_size;
 
-    strm->next_in += 4 * rsi;
-    strm->avail_in -= 4 * rsi;
+    strm->next_in += 4 * n;
+    strm->avail_in -= 4 * n;
 
-    for (i = 0; i < rsi; i++)
+    for (i = 0; i < n; i++)
         out[i] = ((uint32_t)in[4 * i] << 24)
             | ((uint32_t)in[4 * i + 1] << 16)
             | ((uint32_t)in[4 * i + 2] << 8)
             | (uint32_t)in[4 * i + 3];
 }
 
-AEC_GET_RSI_NATIVE_32(lsb)
+AEC_GET_SAMPLES_NATIVE_32(lsb)
 
 #endif /* !WORDS_BIGENDIAN */
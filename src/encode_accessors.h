@@ -50,6 +50,8 @@
 #ifndef ENCODE_ACCESSORS_H
 #define ENCODE_ACCESSORS_H 1
 
+#include <stddef.h>
+
 #if HAVE_STDINT_H
 #  include <stdint.h>
 #endif
@@ -62,12 +64,19 @@ uint32_t aec_get_msb_24(struct aec_stream *strm);
 uint32_t aec_get_lsb_24(struct aec_stream *strm);
 uint32_t aec_get_msb_32(struct aec_stream *strm);
 
-void aec_get_rsi_8(struct aec_stream *strm);
-void aec_get_rsi_lsb_16(struct aec_stream *strm);
-void aec_get_rsi_msb_16(struct aec_stream *strm);
-void aec_get_rsi_lsb_24(struct aec_stream *strm);
-void aec_get_rsi_msb_24(struct aec_stream *strm);
-void aec_get_rsi_lsb_32(struct aec_stream *strm);
-void aec_get_rsi_msb_32(struct aec_stream *strm);
+void aec_get_samples_8(struct aec_stream *strm,
+                       uint32_t *out, size_t n);
+void aec_get_samples_lsb_16(struct aec_stream *strm,
+                            uint32_t *out, size_t n);
+void aec_get_samples_msb_16(struct aec_stream *strm,
+                            uint32_t *out, size_t n);
+void aec_get_samples_lsb_24(struct aec_stream *strm,
+                            uint32_t *out, size_t n);
+void aec_get_samples_msb_24(struct aec_stream *strm,
+                            uint32_t *out, size_t n);
+void aec_get_samples_lsb_32(struct aec_stream *strm,
+                            uint32_t *out, size_t n);
+void aec_get_samples_msb_32(struct aec_stream *strm,
+                            uint32_t *out, size_t n);
 
 #endif /* ENCODE_ACCESSORS_H */
@@ -0,0 +1,311 @@
+/**
+ * @file encode_simd.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Vectorized kernels for the encoder with runtime dispatch
+ *
+ */
+
+#include <config.h>
+
+#if HAVE_STDINT_H
+#  include <stdint.h>
+#endif
+
+#include "encode_simd.h"
+
+#if HAVE_SSE41 || HAVE_AVX2 || HAVE_AVX512F
+#  include <immintrin.h>
+#endif
+
+#if HAVE_AVX2 || HAVE_AVX512F
+__attribute__((target("avx2")))
+static inline __m256i reduce4_avx2(const __m256i *acc)
+{
+    /**
+       Horizontal sums of four vectors returned in one vector.
+    */
+
+    __m256i s01, s23;
+
+    s01 = _mm256_add_epi64(_mm256_unpacklo_epi64(acc[0], acc[1]),
+                           _mm256_unpackhi_epi64(acc[0], acc[1]));
+    s23 = _mm256_add_epi64(_mm256_unpacklo_epi64(acc[2], acc[3]),
+                           _mm256_unpackhi_epi64(acc[2], acc[3]));
+    return _mm256_add_epi64(_mm256_permute2x128_si256(s01, s23, 0x20),
+                            _mm256_permute2x128_si256(s01, s23, 0x31));
+}
+#endif
+
+#if HAVE_AVX2
+__attribute__((target("avx2")))
+static void block_fs_avx2(const uint32_t *block, uint32_t block_size,
+                          int k, uint64_t *fs)
+{
+    /**
+       Samples are widened to 64 bit so the sums can't overflow. Each
+       group of four samples is loaded once and shifted for all
+       splitting positions in the window.
+    */
+
+    uint32_t i;
+    int j;
+    __m256i x;
+    __m256i acc[FS_WINDOW];
+
+    for (j = 0; j < FS_WINDOW; j++)
+        acc[j] = _mm256_setzero_si256();
+
+    for (i = 0; i + 4 <= block_size; i += 4) {
+        x = _mm256_cvtepu32_epi64(
+            _mm_loadu_si128((const __m128i *)(block + i)));
+        for (j = 0; j < FS_WINDOW; j++)
+            acc[j] = _mm256_add_epi64(
+                acc[j], _mm256_srl_epi64(x, _mm_cvtsi32_si128(k + j)));
+    }
+
+    _mm256_storeu_si256((__m256i *)fs, reduce4_avx2(acc));
+
+    for (; i < block_size; i++)
+        for (j = 0; j < FS_WINDOW; j++)
+            fs[j] += (uint64_t)block[i] >> (k + j);
+}
+#endif /* HAVE_AVX2 */
+
+#if HAVE_AVX512F
+__attribute__((target("avx512f")))
+static void block_fs_avx512(const uint32_t *block, uint32_t block_size,
+                            int k, uint64_t *fs)
+{
+    uint32_t i;
+    int j;
+    __m512i x;
+    __m512i acc[FS_WINDOW];
+    __m256i half[FS_WINDOW];
+
+    for (j = 0; j < FS_WINDOW; j++)
+        acc[j] = _mm512_setzero_si512();
+
+    for (i = 0; i + 8 <= block_size; i += 8) {
+        x = _mm512_cvtepu32_epi64(
+            _mm256_loadu_si256((const __m256i *)(block + i)));
+        for (j = 0; j < FS_WINDOW; j++)
+            acc[j] = _mm512_add_epi64(
+                acc[j], _mm512_srl_epi64(x, _mm_cvtsi32_si128(k + j)));
+    }
+
+    for (j = 0; j < FS_WINDOW; j++)
+        half[j] = _mm256_add_epi64(_mm512_castsi512_si256(acc[j]),
+                                   _mm512_extracti64x4_epi64(acc[j], 1));
+    _mm256_storeu_si256((__m256i *)fs, reduce4_avx2(half));
+
+    for (; i < block_size; i++)
+        for (j = 0; j < FS_WINDOW; j++)
+            fs[j] += (uint64_t)block[i] >> (k + j);
+}
+#endif /* HAVE_AVX512F */
+
+/* The preprocessor kernels map the differences of neighbouring
+ * samples like the scalar loops in encode.c but handle one vector of
+ * samples without branches. Unsigned comparisons are done with
+ * min/max since SSE and AVX2 only compare signed integers. */
+
+#if HAVE_SSE41
+__attribute__((target("sse4.1")))
+static size_t preprocess_unsigned_sse41(const uint32_t *x, uint32_t *d,
+                                        size_t n, uint32_t xmin,
+                                        uint32_t xmax, uint32_t m)
+{
+    size_t i;
+    __m128i a, b, ge, D, lim, ok, good, bad;
+    const __m128i vxmax = _mm_set1_epi32((int32_t)xmax);
+    const __m128i ones = _mm_set1_epi32(-1);
+
+    (void)xmin;
+    (void)m;
+    for (i = 0; i + 4 <= n; i += 4) {
+        a = _mm_loadu_si128((const __m128i *)(x + i));
+        b = _mm_loadu_si128((const __m128i *)(x + i + 1));
+        ge = _mm_cmpeq_epi32(_mm_max_epu32(b, a), b);
+        D = _mm_blendv_epi8(_mm_sub_epi32(a, b), _mm_sub_epi32(b, a), ge);
+        lim = _mm_blendv_epi8(_mm_sub_epi32(vxmax, a), a, ge);
+        ok = _mm_cmpeq_epi32(_mm_min_epu32(D, lim), D);
+        good = _mm_add_epi32(_mm_add_epi32(D, D), _mm_xor_si128(ge, ones));
+        bad = _mm_blendv_epi8(_mm_sub_epi32(vxmax, b), b, ge);
+        _mm_storeu_si128((__m128i *)(d + i + 1),
+                         _mm_blendv_epi8(bad, good, ok));
+    }
+    return i;
+}
+
+__attribute__((target("sse4.1")))
+static size_t preprocess_signed_sse41(const uint32_t *x, uint32_t *d,
+                                      size_t n, uint32_t xmin,
+                                      uint32_t xmax, uint32_t m)
+{
+    size_t i;
+    __m128i a, b, lt, D, lim, ok, good, bad;
+    const __m128i vxmin = _mm_set1_epi32((int32_t)xmin);
+    const __m128i vxmax = _mm_set1_epi32((int32_t)xmax);
+    const __m128i vm = _mm_set1_epi32((int32_t)m);
+    const __m128i vmask = _mm_set1_epi32((int32_t)(xmax - xmin));
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        a = _mm_loadu_si128((const __m128i *)(x + i));
+        b = _mm_loadu_si128((const __m128i *)(x + i + 1));
+        a = _mm_and_si128(a, vmask);
+        a = _mm_sub_epi32(_mm_xor_si128(a, vm), vm);
+        b = _mm_and_si128(b, vmask);
+        b = _mm_sub_epi32(_mm_xor_si128(b, vm), vm);
+        lt = _mm_cmpgt_epi32(a, b);
+        D = _mm_blendv_epi8(_mm_sub_epi32(b, a), _mm_sub_epi32(a, b), lt);
+        lim = _mm_blendv_epi8(_mm_sub_epi32(a, vxmin),
+                              _mm_sub_epi32(vxmax, a), lt);
+        ok = _mm_cmpeq_epi32(_mm_min_epu32(D, lim), D);
+        good = _mm_add_epi32(_mm_add_epi32(D, D), lt);
+        bad = _mm_blendv_epi8(_mm_sub_epi32(b, vxmin),
+                              _mm_sub_epi32(vxmax, b), lt);
+        _mm_storeu_si128((__m128i *)(d + i + 1),
+                         _mm_blendv_epi8(bad, good, ok));
+    }
+    return i;
+}
+#endif /* HAVE_SSE41 */
+
+#if HAVE_AVX2
+__attribute__((target("avx2")))
+static size_t preprocess_unsigned_avx2(const uint32_t *x, uint32_t *d,
+                                       size_t n, uint32_t xmin,
+                                       uint32_t xmax, uint32_t m)
+{
+    size_t i;
+    __m256i a, b, ge, D, lim, ok, good, bad;
+    const __m256i vxmax = _mm256_set1_epi32((int32_t)xmax);
+    const __m256i ones = _mm256_set1_epi32(-1);
+
+    (void)xmin;
+    (void)m;
+    for (i = 0; i + 8 <= n; i += 8) {
+        a = _mm256_loadu_si256((const __m256i *)(x + i));
+        b = _mm256_loadu_si256((const __m256i *)(x + i + 1));
+        ge = _mm256_cmpeq_epi32(_mm256_max_epu32(b, a), b);
+        D = _mm256_blendv_epi8(_mm256_sub_epi32(a, b),
+                               _mm256_sub_epi32(b, a), ge);
+        lim = _mm256_blendv_epi8(_mm256_sub_epi32(vxmax, a), a, ge);
+        ok = _mm256_cmpeq_epi32(_mm256_min_epu32(D, lim), D);
+        good = _mm256_add_epi32(_mm256_add_epi32(D, D),
+                                _mm256_xor_si256(ge, ones));
+        bad = _mm256_blendv_epi8(_mm256_sub_epi32(vxmax, b), b, ge);
+        _mm256_storeu_si256((__m256i *)(d + i + 1),
+                            _mm256_blendv_epi8(bad, good, ok));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t preprocess_signed_avx2(const uint32_t *x, uint32_t *d,
+                                     size_t n, uint32_t xmin,
+                                     uint32_t xmax, uint32_t m)
+{
+    size_t i;
+    __m256i a, b, lt, D, lim, ok, good, bad;
+    const __m256i vxmin = _mm256_set1_epi32((int32_t)xmin);
+    const __m256i vxmax = _mm256_set1_epi32((int32_t)xmax);
+    const __m256i vm = _mm256_set1_epi32((int32_t)m);
+    const __m256i vmask = _mm256_set1_epi32((int32_t)(xmax - xmin));
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        a = _mm256_loadu_si256((const __m256i *)(x + i));
+        b = _mm256_loadu_si256((const __m256i *)(x + i + 1));
+        a = _mm256_and_si256(a, vmask);
+        a = _mm256_sub_epi32(_mm256_xor_si256(a, vm), vm);
+        b = _mm256_and_si256(b, vmask);
+        b = _mm256_sub_epi32(_mm256_xor_si256(b, vm), vm);
+        lt = _mm256_cmpgt_epi32(a, b);
+        D = _mm256_blendv_epi8(_mm256_sub_epi32(b, a),
+                               _mm256_sub_epi32(a, b), lt);
+        lim = _mm256_blendv_epi8(_mm256_sub_epi32(a, vxmin),
+                                 _mm256_sub_epi32(vxmax, a), lt);
+        ok = _mm256_cmpeq_epi32(_mm256_min_epu32(D, lim), D);
+        good = _mm256_add_epi32(_mm256_add_epi32(D, D), lt);
+        bad = _mm256_blendv_epi8(_mm256_sub_epi32(b, vxmin),
+                                 _mm256_sub_epi32(vxmax, b), lt);
+        _mm256_storeu_si256((__m256i *)(d + i + 1),
+                            _mm256_blendv_epi8(bad, good, ok));
+    }
+    return i;
+}
+#endif /* HAVE_AVX2 */
+
+aec_block_fs_t aec_select_block_fs(uint32_t block_size)
+{
+    /**
+       The AVX-512 kernel only pays off if the block fills several
+       vectors.
+    */
+
+#if HAVE_AVX512F
+    if (block_size >= 32 && __builtin_cpu_supports("avx512f"))
+        return block_fs_avx512;
+#endif
+#if HAVE_AVX2
+    if (block_size >= 8 && __builtin_cpu_supports("avx2"))
+        return block_fs_avx2;
+#endif
+    return NULL;
+}
+
+aec_preprocess_t aec_select_preprocess(int is_signed)
+{
+#if HAVE_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        return is_signed? preprocess_signed_avx2: preprocess_unsigned_avx2;
+#endif
+#if HAVE_SSE41
+    if (__builtin_cpu_supports("sse4.1"))
+        return is_signed? preprocess_signed_sse41: preprocess_unsigned_sse41;
+#endif
+    (void)is_signed;
+    return NULL;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file encode_simd.h
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Vectorized kernels for the encoder with runtime dispatch
+ *
+ */
+
+#ifndef ENCODE_SIMD_H
+#define ENCODE_SIMD_H 1
+
+#include <config.h>
+#include <stddef.h>
+
+#if HAVE_STDINT_H
+#  include <stdint.h>
+#endif
+
+/* Number of consecutive splitting positions evaluated by one call of
+ * a block_fs kernel. The kernels store the sums with a single vector
+ * of four 64 bit lanes. */
+#define FS_WINDOW 4
+
+/* Store the FS length of block for splitting positions k, ..., k +
+ * FS_WINDOW - 1 in fs. */
+typedef void (*aec_block_fs_t)(const uint32_t *block, uint32_t block_size,
+                               int k, uint64_t *fs);
+
+/* Return the fastest block_fs kernel supported by the CPU for the
+ * given block size or NULL if the scalar code should be used */
+aec_block_fs_t aec_select_block_fs(uint32_t block_size);
+
+/* Compute preprocessed samples d[i + 1] from x[i] and x[i + 1] for
+ * i = 0, ..., n - 1 as far as full vectors reach. Returns the number
+ * of samples done, the rest is left to the scalar code. Signed
+ * samples are sign extended from the bit m on the fly, x is not
+ * modified. */
+typedef size_t (*aec_preprocess_t)(const uint32_t *x, uint32_t *d,
+                                   size_t n, uint32_t xmin,
+                                   uint32_t xmax, uint32_t m);
+
+/* Return the fastest preprocessor kernel supported by the CPU or
+ * NULL if the scalar code should be used */
+aec_preprocess_t aec_select_preprocess(int is_signed);
+
+#endif /* ENCODE_SIMD_H */
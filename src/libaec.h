@@ -94,6 +94,62 @@ struct aec_stream {
     unsigned int flags;
 
     struct internal_state *state;
+
+    /* Memory management functions which replace malloc and free if
+     * AEC_CUSTOM_ALLOC is set. They are called with opaque as the
+     * first argument. zalloc returns NULL if no memory is available.
+     * The multithreaded functions call them concurrently. Unlike zlib,
+     * the library never sets these members. */
+    void *(*zalloc)(void *opaque, size_t items, size_t size);
+    void (*zfree)(void *opaque, void *address);
+    void *opaque;
+};
+
+/* Input and output of one buffer coded by aec_buffer_encode_batch()
+ * or aec_buffer_decode_batch() */
+struct aec_buffer {
+    const unsigned char *next_in;
+    size_t avail_in;
+    unsigned char *next_out;
+    size_t avail_out;
+
+    /* number of bytes output, set by the library */
+    size_t total_out;
+
+    /* return code of coding this buffer, set by the library */
+    int status;
+};
+
+/* Runs of zero blocks are counted up to this length. Runs are never
+ * longer than a segment of 64 blocks. */
+#define AEC_STATS_RUNS 65
+
+/* Splitting positions k = 0, ..., AEC_STATS_KMAX - 1 */
+#define AEC_STATS_KMAX 32
+
+/* Code option statistics collected by the encoder or decoder. Bits
+ * are counted for whole Coded Data Sets, including option ID and
+ * reference sample. */
+struct aec_stats {
+    /* blocks and bits coded with splitting position k, k = 0 being
+     * the fundamental sequence option */
+    size_t split_blocks[AEC_STATS_KMAX];
+    size_t split_bits[AEC_STATS_KMAX];
+
+    /* blocks and bits coded with the second extension option */
+    size_t se_blocks;
+    size_t se_bits;
+
+    /* zero blocks and bits of the zero block option */
+    size_t zero_blocks;
+    size_t zero_bits;
+
+    /* number of runs of n zero blocks at index n */
+    size_t zero_runs[AEC_STATS_RUNS];
+
+    /* blocks and bits coded without compression */
+    size_t uncomp_blocks;
+    size_t uncomp_bits;
 };
 
 /*********************************/
@@ -117,12 +173,18 @@ struct aec_stream {
 /* Use restricted set of code options */
 #define AEC_RESTRICTED 16
 
-/* Pad RSI to byte boundary. Only for decoding CCSDS sample data. */
+/* Pad RSI to byte boundary. Padded RSIs can be encoded in
+ * parallel. */
 #define AEC_PAD_RSI 32
 
 /* Do not enforce standard regarding legal block sizes. */
 #define AEC_NOT_ENFORCE 64
 
+/* Allocate memory with zalloc and zfree. Without this flag these
+ * members are ignored, so that programs which do not know about them
+ * keep working. */
+#define AEC_CUSTOM_ALLOC 128
+
 /*************************************/
 /* Return codes of library functions */
 /*************************************/
@@ -131,6 +193,7 @@ struct aec_stream {
 #define AEC_STREAM_ERROR (-2)
 #define AEC_DATA_ERROR (-3)
 #define AEC_MEM_ERROR (-4)
+#define AEC_RSI_OFFSETS_ERROR (-5)
 
 /************************/
 /* Options for flushing */
@@ -145,7 +208,9 @@ struct aec_stream {
  *
  * It is not possible to continue encoding of the same stream after it
  * has been flushed because the last byte may be padded with fill
- * bits. */
+ * bits. Flushing is complete if avail_out is not zero after the
+ * call. Calling aec_encode() with AEC_FLUSH again after that adds no
+ * output. */
 #define AEC_FLUSH 1
 
 /*********************************************/
@@ -155,14 +220,164 @@ LIBAEC_DLL_EXPORTED int aec_encode_init(struct aec_stream *strm);
 LIBAEC_DLL_EXPORTED int aec_encode(struct aec_stream *strm, int flush);
 LIBAEC_DLL_EXPORTED int aec_encode_end(struct aec_stream *strm);
 
+/* Start a new stream with an initialized encoder. Buffers are kept
+ * if bits_per_sample, block_size, rsi and flags did not change. With
+ * invalid parameters the reset fails with AEC_CONF_ERROR and the
+ * encoder is kept unchanged. If setting up the new state fails, the
+ * encoder is released. Reset and aec_encode_end() then return
+ * AEC_STREAM_ERROR. */
+LIBAEC_DLL_EXPORTED int aec_encode_reset(struct aec_stream *strm);
+
+/* Record the bit offset of every RSI in the encoded stream. Call
+ * after aec_encode_init(). Offsets have to be retrieved before
+ * aec_encode_end(). */
+LIBAEC_DLL_EXPORTED int aec_encode_enable_offsets(struct aec_stream *strm);
+LIBAEC_DLL_EXPORTED int aec_encode_count_offsets(struct aec_stream *strm,
+                                                 size_t *count);
+LIBAEC_DLL_EXPORTED int aec_encode_get_offsets(struct aec_stream *strm,
+                                               size_t *offsets,
+                                               size_t count);
+
+/* Count blocks and bits per code option. Call after
+ * aec_encode_init(). Statistics are retrieved with
+ * aec_encode_get_stats() before aec_encode_end() and cleared by
+ * aec_encode_reset(). */
+LIBAEC_DLL_EXPORTED int aec_encode_enable_stats(struct aec_stream *strm);
+LIBAEC_DLL_EXPORTED int aec_encode_get_stats(struct aec_stream *strm,
+                                             struct aec_stats *stats);
+
 LIBAEC_DLL_EXPORTED int aec_decode_init(struct aec_stream *strm);
 LIBAEC_DLL_EXPORTED int aec_decode(struct aec_stream *strm, int flush);
 LIBAEC_DLL_EXPORTED int aec_decode_end(struct aec_stream *strm);
 
+/* Start a new stream with an initialized decoder. Buffers and tables
+ * are kept if bits_per_sample, block_size, rsi and flags did not
+ * change. With invalid parameters the reset fails with
+ * AEC_CONF_ERROR and the decoder is kept unchanged. If setting up the
+ * new state fails, the decoder is released. Reset and
+ * aec_decode_end() then return AEC_STREAM_ERROR. */
+LIBAEC_DLL_EXPORTED int aec_decode_reset(struct aec_stream *strm);
+
+/* Same as aec_encode_enable_stats() and aec_encode_get_stats() for
+ * the decoder. Blocks are counted once they are completely
+ * decoded. */
+LIBAEC_DLL_EXPORTED int aec_decode_enable_stats(struct aec_stream *strm);
+LIBAEC_DLL_EXPORTED int aec_decode_get_stats(struct aec_stream *strm,
+                                             struct aec_stats *stats);
+
+/* Position the input of an initialized decoder at the RSI starting
+ * at the given bit offset from next_in. Decoding in progress is
+ * dropped and restarts at the reference sample of that RSI. */
+LIBAEC_DLL_EXPORTED int aec_buffer_seek(struct aec_stream *strm,
+                                        size_t offset);
+
+/* Find the bit offsets of all RSIs in the coded stream at next_in
+ * without decoding it. Much faster than decoding, this provides
+ * offsets for streams which were encoded without recording them.
+ * Input pointers are left untouched. Offsets are retrieved with
+ * aec_decode_count_offsets() and aec_decode_get_offsets(). */
+LIBAEC_DLL_EXPORTED int aec_decode_scan_offsets(struct aec_stream *strm);
+LIBAEC_DLL_EXPORTED int aec_decode_count_offsets(struct aec_stream *strm,
+                                                 size_t *count);
+LIBAEC_DLL_EXPORTED int aec_decode_get_offsets(struct aec_stream *strm,
+                                               size_t *offsets,
+                                               size_t count);
+
+/* Decode size bytes starting at byte pos of the decoded data. Only
+ * RSIs covering the range are decoded. next_in has to point to the
+ * start of the coded stream, rsi_offsets are the bit offsets of all
+ * RSIs as recorded by the encoder. pos and size have to be multiples
+ * of the storage size of a sample. */
+LIBAEC_DLL_EXPORTED int aec_decode_range(struct aec_stream *strm,
+                                         const size_t *rsi_offsets,
+                                         size_t rsi_offsets_count,
+                                         size_t pos, size_t size);
+
 /***************************************************************/
 /* Utility functions for encoding or decoding a memory buffer. */
 /***************************************************************/
 LIBAEC_DLL_EXPORTED int aec_buffer_encode(struct aec_stream *strm);
 LIBAEC_DLL_EXPORTED int aec_buffer_decode(struct aec_stream *strm);
 
+/* Encode a memory buffer which consists of lines of line_len samples
+ * (up to rsi * block_size). Every line, including a short last line,
+ * is coded as one RSI, padded with its last sample if preprocessing
+ * is enabled and with zeros otherwise. */
+LIBAEC_DLL_EXPORTED int aec_buffer_encode_lines(struct aec_stream *strm,
+                                                size_t line_len);
+
+/* Decode a stream made by aec_buffer_encode_lines(). Only the first
+ * line_len samples of every RSI are written to next_out, the padding
+ * is dropped. */
+LIBAEC_DLL_EXPORTED int aec_buffer_decode_lines(struct aec_stream *strm,
+                                                size_t line_len);
+
+/* Same as aec_buffer_encode() and aec_buffer_decode() but with a
+ * stream initialized by aec_encode_init() or aec_decode_init(). The
+ * stream is reset before coding and kept for further calls, which
+ * avoids setting up the state for every buffer. Release it with
+ * aec_encode_end() or aec_decode_end(). */
+LIBAEC_DLL_EXPORTED int aec_buffer_encode_ctx(struct aec_stream *strm);
+LIBAEC_DLL_EXPORTED int aec_buffer_decode_ctx(struct aec_stream *strm);
+
+/* Encode a memory buffer using up to nthreads threads. RSIs are coded
+ * independently if AEC_PAD_RSI is set. Output is identical to
+ * aec_buffer_encode(). Without AEC_PAD_RSI this is the same as
+ * calling aec_buffer_encode(). */
+LIBAEC_DLL_EXPORTED int aec_buffer_encode_mt(struct aec_stream *strm,
+                                             int nthreads);
+
+/* Decode a memory buffer using up to nthreads threads. RSIs are
+ * located with the offsets recorded by the encoder and decoded
+ * concurrently. */
+LIBAEC_DLL_EXPORTED int aec_buffer_decode_mt(struct aec_stream *strm,
+                                             const size_t *rsi_offsets,
+                                             size_t rsi_offsets_count,
+                                             int nthreads);
+
+/* Code count independent buffers like aec_buffer_encode() or
+ * aec_buffer_decode() would, using up to nthreads threads. Parameters
+ * are taken from strm, all other members of strm are ignored. Streams
+ * are set up once per group of buffers instead of once per buffer.
+ * Sizes and return codes of all buffers are stored in their
+ * descriptors. Returns the first return code which is not AEC_OK. */
+LIBAEC_DLL_EXPORTED int aec_buffer_encode_batch(struct aec_stream *strm,
+                                                struct aec_buffer *buffers,
+                                                size_t count, int nthreads);
+LIBAEC_DLL_EXPORTED int aec_buffer_decode_batch(struct aec_stream *strm,
+                                                struct aec_buffer *buffers,
+                                                size_t count, int nthreads);
+
+/***************************************************/
+/* Thread pool shared by parallel buffer functions */
+/***************************************************/
+
+/* A pool of nthreads worker threads which are kept until the pool is
+ * destroyed. Jobs are split among workers which steal from each other
+ * when idle. Any number of threads may pass the same pool to the
+ * functions below concurrently. The calling thread joins the workers
+ * until its jobs are done. Returns NULL if no thread can be started
+ * or threads are not supported. */
+struct aec_pool;
+LIBAEC_DLL_EXPORTED struct aec_pool *aec_pool_create(int nthreads);
+
+/* Stop all workers and free the pool. No function may be using it. */
+LIBAEC_DLL_EXPORTED void aec_pool_destroy(struct aec_pool *pool);
+
+/* Same as the functions ending in _mt or _batch but with the threads
+ * of pool instead of threads started for the call. If pool is NULL,
+ * the calling thread does all the work. */
+LIBAEC_DLL_EXPORTED int aec_buffer_encode_pool(struct aec_stream *strm,
+                                               struct aec_pool *pool);
+LIBAEC_DLL_EXPORTED int aec_buffer_decode_pool(struct aec_stream *strm,
+                                               const size_t *rsi_offsets,
+                                               size_t rsi_offsets_count,
+                                               struct aec_pool *pool);
+LIBAEC_DLL_EXPORTED int aec_buffer_encode_batch_pool(
+    struct aec_stream *strm, struct aec_buffer *buffers, size_t count,
+    struct aec_pool *pool);
+LIBAEC_DLL_EXPORTED int aec_buffer_decode_batch_pool(
+    struct aec_stream *strm, struct aec_buffer *buffers, size_t count,
+    struct aec_pool *pool);
+
 #endif /* LIBAEC_H */
@@ -0,0 +1,104 @@
+/**
+ * @file stats.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Code option statistics
+ *
+ */
+
+#include <config.h>
+#include <string.h>
+
+#include "libaec.h"
+#include "alloc.h"
+#include "stats.h"
+
+struct aec_stats *stats_create(const struct aec_allocator *alloc)
+{
+    struct aec_stats *stats = aec_alloc(alloc, sizeof(struct aec_stats));
+    if (stats == NULL)
+        return NULL;
+
+    stats_clear(stats);
+    return stats;
+}
+
+void stats_destroy(const struct aec_allocator *alloc,
+                   struct aec_stats *stats)
+{
+    aec_free(alloc, stats);
+}
+
+void stats_clear(struct aec_stats *stats)
+{
+    if (stats != NULL)
+        memset(stats, 0, sizeof(struct aec_stats));
+}
+
+void stats_add(struct aec_stats *stats, int option, uint32_t blocks,
+               size_t bits)
+{
+    switch (option) {
+    case STATS_NONE:
+        break;
+    case STATS_SE:
+        stats->se_blocks += blocks;
+        stats->se_bits += bits;
+        break;
+    case STATS_ZERO:
+        stats->zero_blocks += blocks;
+        stats->zero_bits += bits;
+        if (blocks < AEC_STATS_RUNS)
+            stats->zero_runs[blocks]++;
+        break;
+    case STATS_UNCOMP:
+        stats->uncomp_blocks += blocks;
+        stats->uncomp_bits += bits;
+        break;
+    default:
+        stats->split_blocks[option] += blocks;
+        stats->split_bits[option] += bits;
+        break;
+    }
+}
@@ -0,0 +1,80 @@
+/**
+ * @file stats.h
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Code option statistics
+ *
+ */
+
+#ifndef STATS_H
+#define STATS_H 1
+
+#include <config.h>
+#include <stddef.h>
+
+#if HAVE_STDINT_H
+#  include <stdint.h>
+#endif
+
+/* Code options other than splitting, which is passed as k >= 0 */
+#define STATS_NONE (-1)
+#define STATS_SE (-2)
+#define STATS_ZERO (-3)
+#define STATS_UNCOMP (-4)
+
+struct aec_allocator;
+struct aec_stats;
+
+/* Memory is managed with the allocation functions of alloc */
+struct aec_stats *stats_create(const struct aec_allocator *alloc);
+void stats_destroy(const struct aec_allocator *alloc,
+                   struct aec_stats *stats);
+void stats_clear(struct aec_stats *stats);
+
+/* Count a CDS of the given option which covers blocks blocks and
+ * is bits long */
+void stats_add(struct aec_stats *stats, int option, uint32_t blocks,
+               size_t bits);
+
+#endif /* STATS_H */
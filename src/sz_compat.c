@@ -5,10 +5,14 @@
 #  include <config.h>
 #endif
 #include "szlib.h"
+#include "sz_simd.h"
 
 #define NOPTS 129
 #define MIN(a, b) (((a) < (b))? (a): (b))
 
+/* Words transposed at a time by the scalar interleave code */
+#define INTERLEAVE_TILE 512
+
 static int convert_options(int sz_opts)
 {
     int co[NOPTS];
@@ -36,74 +40,50 @@ static int bits_to_bytes(int bit_length)
         return 1;
 }
 
-static void interleave_buffer(void *dest, const void *src,
-                              size_t n, int wordsize)
+static void interleave_words(unsigned char *dest, const unsigned char *src,
+                             size_t n, size_t stride, int wordsize)
 {
-    size_t i;
+    /**
+       Split n words into byte planes stride bytes apart. The scalar
+       code transposes tiles of INTERLEAVE_TILE words so that the
+       source of a tile stays in cache while each byte plane is
+       written sequentially.
+    */
+
+    size_t i, k, end;
     int j;
-    const unsigned char *src8;
-    unsigned char *dest8;
+    sz_transpose_t kernel;
 
-    src8 = (unsigned char *)src;
-    dest8 = (unsigned char *)dest;
+    i = 0;
+    kernel = sz_select_interleave(wordsize);
+    if (kernel)
+        i = kernel(dest, src, n, stride);
 
-    for (i = 0; i < n / wordsize; i++)
+    for (; i < n; i = end) {
+        end = MIN(i + INTERLEAVE_TILE, n);
         for (j = 0; j < wordsize; j++)
-            dest8[j * (n / wordsize) + i] = src8[i * wordsize + j];
+            for (k = i; k < end; k++)
+                dest[j * stride + k] = src[k * wordsize + j];
+    }
 }
 
-static void deinterleave_buffer(void *dest, const void *src,
-                                size_t n, int wordsize)
+static void deinterleave_words(unsigned char *dest, const unsigned char *src,
+                               size_t n, size_t stride, int wordsize)
 {
-    size_t i;
+    size_t i, k, end;
     int j;
-    const unsigned char *src8;
-    unsigned char *dest8;
-
-    src8 = (unsigned char *)src;
-    dest8 = (unsigned char *)dest;
-
-    for (i = 0; i < n / wordsize; i++)
-        for (j = 0; j < wordsize; j++)
-            dest8[i * wordsize + j] = src8[j * (n / wordsize) + i];
-}
-
-static void add_padding(void *dest, const void *src, size_t src_length,
-                        size_t line_size, size_t padding_size,
-                        int pixel_size, int pp)
-{
-    size_t i, j, k, ls, ps;
-    const char *pixel;
-    const char zero_pixel[] = {0, 0, 0, 0};
+    sz_transpose_t kernel;
 
-    pixel = zero_pixel;
-    j = 0;
     i = 0;
-    while (i < src_length) {
-        ls = MIN(src_length - i, line_size);
-        memcpy((char *)dest + j, (char *)src + i, ls);
-        j += ls;
-        i += ls;
-        if (pp)
-            pixel = (char *)src + i - pixel_size;
-        ps = line_size + padding_size - ls;
-        for (k = 0; k < ps; k += pixel_size)
-            memcpy((char *)dest + j + k, pixel, pixel_size);
-        j += ps;
-    }
-}
-
-static void remove_padding(void *buf, size_t buf_length,
-                           size_t line_size, size_t padding_size,
-                           int pixel_size)
-{
-    size_t i, j;
-    size_t padded_line_size = line_size + padding_size;
+    kernel = sz_select_deinterleave(wordsize);
+    if (kernel)
+        i = kernel(dest, src, n, stride);
 
-    i = line_size;
-    for (j = padded_line_size; j < buf_length; j += padded_line_size) {
-        memmove((char *)buf + i, (char *)buf + j, line_size);
-        i += line_size;
+    for (; i < n; i = end) {
+        end = MIN(i + INTERLEAVE_TILE, n);
+        for (j = 0; j < wordsize; j++)
+            for (k = i; k < end; k++)
+                dest[k * wordsize + j] = src[j * stride + k];
     }
 }
 
@@ -114,13 +94,9 @@ int SZ_BufftoBuffCompress(void *dest, size_t *destLen,
     struct aec_stream strm;
     int status;
     int aec_status;
-    void *padbuf;
     void *buf;
-    size_t padding_size;
-    size_t scanlines;
-    size_t padbuf_size;
-    int pixel_size;
     int interleave;
+    int wordsize;
 
     strm.block_size = param->pixels_per_block;
     strm.rsi = (param->pixels_per_scanline + param->pixels_per_block - 1)
@@ -129,7 +105,6 @@ int SZ_BufftoBuffCompress(void *dest, size_t *destLen,
     strm.avail_out = *destLen;
     strm.next_out = dest;
     buf = 0;
-    padbuf = 0;
 
     interleave = param->bits_per_pixel == 32 || param->bits_per_pixel == 64;
     if (interleave) {
@@ -139,35 +114,19 @@ int SZ_BufftoBuffCompress(void *dest, size_t *destLen,
             status = SZ_MEM_ERROR;
             goto CLEANUP;
         }
-        interleave_buffer(buf, source, sourceLen, param->bits_per_pixel / 8);
+        wordsize = param->bits_per_pixel / 8;
+        interleave_words(buf, source, sourceLen / wordsize,
+                         sourceLen / wordsize, wordsize);
     } else {
         strm.bits_per_sample = param->bits_per_pixel;
         buf = (void *)source;
     }
 
-    pixel_size = bits_to_bytes(strm.bits_per_sample);
-
-    scanlines = (sourceLen / pixel_size + param->pixels_per_scanline - 1)
-        / param->pixels_per_scanline;
-    padbuf_size = strm.rsi * strm.block_size * pixel_size * scanlines;
-    padbuf = malloc(padbuf_size);
-    if (padbuf == NULL) {
-        status = SZ_MEM_ERROR;
-        goto CLEANUP;
-    }
-
-    padding_size =
-        (strm.rsi * strm.block_size - param->pixels_per_scanline)
-        * pixel_size;
-
-    add_padding(padbuf, buf, sourceLen,
-                param->pixels_per_scanline * pixel_size,
-                padding_size, pixel_size,
-                strm.flags & AEC_DATA_PREPROCESS);
-    strm.next_in = padbuf;
-    strm.avail_in = padbuf_size;
+    /* Scanlines are padded to whole RSIs by the encoder */
+    strm.next_in = buf;
+    strm.avail_in = sourceLen;
 
-    aec_status = aec_buffer_encode(&strm);
+    aec_status = aec_buffer_encode_lines(&strm, param->pixels_per_scanline);
     if (aec_status == AEC_STREAM_ERROR)
         status = SZ_OUTBUFF_FULL;
     else
@@ -175,8 +134,6 @@ int SZ_BufftoBuffCompress(void *dest, size_t *destLen,
     *destLen = strm.total_out;
 
 CLEANUP:
-    if (padbuf)
-        free(padbuf);
     if (interleave && buf)
         free(buf);
     return status;
@@ -189,13 +146,8 @@ int SZ_BufftoBuffDecompress(void *dest, size_t *destLen,
     struct aec_stream strm;
     int status;
     void *buf;
-    size_t padding_size;
-    size_t scanlines;
-    size_t buf_size, total_out;
-    int pixel_size;
-    int pad_scanline;
     int deinterleave;
-    int extra_buffer;
+    int wordsize;
 
     strm.block_size = param->pixels_per_block;
     strm.rsi = (param->pixels_per_scanline + param->pixels_per_block - 1)
@@ -205,63 +157,37 @@ int SZ_BufftoBuffDecompress(void *dest, size_t *destLen,
     strm.next_in = source;
     buf = 0;
 
-    pad_scanline = param->pixels_per_scanline % param->pixels_per_block;
     deinterleave = param->bits_per_pixel == 32 || param->bits_per_pixel == 64;
-    extra_buffer = pad_scanline || deinterleave;
-
-    if (deinterleave)
+    if (deinterleave) {
         strm.bits_per_sample = 8;
-    else
-        strm.bits_per_sample = param->bits_per_pixel;
-
-    pixel_size = bits_to_bytes(strm.bits_per_sample);
-
-    if (extra_buffer) {
-        if (pad_scanline) {
-            scanlines = (*destLen / pixel_size + param->pixels_per_scanline - 1)
-                / param->pixels_per_scanline;
-            buf_size = strm.rsi * strm.block_size * pixel_size * scanlines;
-        } else {
-            buf_size = *destLen;
-        }
-        buf = malloc(buf_size);
+        buf = malloc(*destLen);
         if (buf == NULL) {
             status = SZ_MEM_ERROR;
             goto CLEANUP;
         }
         strm.next_out = buf;
-        strm.avail_out = buf_size;
     } else {
+        strm.bits_per_sample = param->bits_per_pixel;
         strm.next_out = dest;
-        strm.avail_out = *destLen;
     }
+    strm.avail_out = *destLen;
 
-    status = aec_buffer_decode(&strm);
+    /* The decoder drops the padding of scanlines */
+    status = aec_buffer_decode_lines(&strm, param->pixels_per_scanline);
     if (status != AEC_OK)
         goto CLEANUP;
 
-    if (pad_scanline) {
-        padding_size =
-            (strm.rsi * strm.block_size - param->pixels_per_scanline)
-            * pixel_size;
-        remove_padding(buf, strm.total_out,
-                       param->pixels_per_scanline * pixel_size,
-                       padding_size, pixel_size);
-        total_out = scanlines * param->pixels_per_scanline * pixel_size;
-    } else {
-        total_out = strm.total_out;
-    }
-
-    if (total_out < *destLen)
-        *destLen = total_out;
+    if (strm.total_out < *destLen)
+        *destLen = strm.total_out;
 
-    if (deinterleave)
-        deinterleave_buffer(dest, buf, *destLen, param->bits_per_pixel / 8);
-    else if (pad_scanline)
-        memcpy(dest, buf, *destLen);
+    if (deinterleave) {
+        wordsize = param->bits_per_pixel / 8;
+        deinterleave_words(dest, buf, *destLen / wordsize,
+                           *destLen / wordsize, wordsize);
+    }
 
 CLEANUP:
-    if (extra_buffer && buf)
+    if (deinterleave && buf)
         free(buf);
 
     return status;
@@ -272,5 +198,430 @@ int SZ_encoder_enabled(void)
     return 1;
 }
 
-/* netcdf searches for SZ_Compress in configure */
-char SZ_Compress() { return SZ_OK; }
+struct sz_internal_state {
+    struct aec_stream strm;
+
+    /* storage size of samples passed to libaec in bytes */
+    int pixel_size;
+
+    /* bytes per pixel if pixels are split into byte planes, 0
+     * otherwise */
+    int wordsize;
+
+    /* bytes of a scanline and of a scanline padded to a full RSI */
+    size_t line_size;
+    size_t rsi_size;
+
+    /* one scanline padded to a full RSI */
+    unsigned char *line;
+
+    /* bytes of line filled with input or decoded output */
+    size_t line_fill;
+
+    /* bytes of line copied to the output */
+    size_t line_pos;
+
+    /* byte planes of the whole image or NULL */
+    unsigned char *planes;
+
+    /* bytes of planes encoded or decoded */
+    size_t planes_coded;
+
+    /* size of the image in bytes, 0 if unknown */
+    size_t image_size;
+
+    /* bytes of the image read from or written to the user */
+    size_t image_pos;
+};
+
+static void interleave_bytes(struct sz_internal_state *state,
+                             const unsigned char *src, size_t n)
+{
+    /**
+       Move the next n bytes of the image into the byte planes. Only
+       the parts of words at the start and end are moved byte by
+       byte.
+    */
+
+    size_t pos, count, words;
+    int ws = state->wordsize;
+    unsigned char *planes = state->planes;
+
+    pos = state->image_pos;
+    count = state->image_size / ws;
+    state->image_pos += n;
+
+    for (; n > 0 && pos % ws; n--, pos++)
+        planes[pos % ws * count + pos / ws] = *src++;
+
+    words = n / ws;
+    interleave_words(planes + pos / ws, src, words, count, ws);
+    src += words * ws;
+    pos += words * ws;
+    n -= words * ws;
+
+    for (; n > 0; n--, pos++)
+        planes[pos % ws * count + pos / ws] = *src++;
+}
+
+static void deinterleave_bytes(struct sz_internal_state *state,
+                               unsigned char *dest, size_t n)
+{
+    size_t pos, count, words;
+    int ws = state->wordsize;
+    const unsigned char *planes = state->planes;
+
+    pos = state->image_pos;
+    count = state->image_size / ws;
+    state->image_pos += n;
+
+    for (; n > 0 && pos % ws; n--, pos++)
+        *dest++ = planes[pos % ws * count + pos / ws];
+
+    words = n / ws;
+    deinterleave_words(dest, planes + pos / ws, words, count, ws);
+    dest += words * ws;
+    pos += words * ws;
+    n -= words * ws;
+
+    for (; n > 0; n--, pos++)
+        *dest++ = planes[pos % ws * count + pos / ws];
+}
+
+static void pad_line(struct sz_internal_state *state)
+{
+    /**
+       Fill the RSI after a possibly short scanline like
+       aec_buffer_encode_lines() does: repeat the last pixel with
+       preprocessing, use zeros otherwise.
+    */
+
+    size_t i, fill;
+    int size = state->pixel_size;
+
+    fill = state->line_fill - state->line_fill % size;
+    if (state->strm.flags & AEC_DATA_PREPROCESS) {
+        for (i = fill; i < state->rsi_size; i += size)
+            memcpy(state->line + i, state->line + fill - size, size);
+    } else {
+        memset(state->line + fill, 0, state->rsi_size - fill);
+    }
+}
+
+static int encode_lines(struct sz_internal_state *state,
+                        const unsigned char **src, size_t *avail,
+                        int finish)
+{
+    /**
+       Encode as much of src as the output takes. Every scanline,
+       including a short last one, is padded to a full RSI. Returns
+       SZ_STREAM_END if finish is set and the stream is complete.
+    */
+
+    size_t n;
+    struct aec_stream *strm = &state->strm;
+
+    for (;;) {
+        if (strm->avail_in == 0) {
+            if (state->line_fill == 0 && state->line_size == state->rsi_size
+                && *avail >= state->rsi_size) {
+                /* Whole RSIs straight from the input. The encoder
+                 * takes input by RSIs, so nothing is left in
+                 * between. */
+                n = *avail - *avail % state->rsi_size;
+                strm->next_in = *src;
+                strm->avail_in = n;
+                aec_encode(strm, AEC_NO_FLUSH);
+                *src = strm->next_in;
+                *avail -= n - strm->avail_in;
+                if (strm->avail_in > 0) {
+                    strm->avail_in = 0;
+                    return SZ_OK;
+                }
+                continue;
+            }
+
+            n = MIN(*avail, state->line_size - state->line_fill);
+            memcpy(state->line + state->line_fill, *src, n);
+            *src += n;
+            *avail -= n;
+            state->line_fill += n;
+            if (state->line_fill == 0
+                || (state->line_fill < state->line_size && !finish))
+                break;
+
+            pad_line(state);
+            strm->next_in = state->line;
+            strm->avail_in = state->rsi_size;
+            state->line_fill = 0;
+        }
+        aec_encode(strm, AEC_NO_FLUSH);
+        if (strm->avail_in > 0)
+            return SZ_OK;
+    }
+
+    if (finish) {
+        aec_encode(strm, AEC_FLUSH);
+        if (strm->avail_out > 0)
+            return SZ_STREAM_END;
+    }
+    return SZ_OK;
+}
+
+static int decode_lines(struct sz_internal_state *state,
+                        unsigned char **dest, size_t *avail)
+{
+    /**
+       Decode into dest until it is full or all input is used up.
+       Padding at the end of scanlines is dropped. Without padding,
+       whole pixels are decoded straight into dest and line only
+       takes pixels which do not fit completely.
+    */
+
+    int status;
+    size_t n;
+    int direct = state->line_size == state->rsi_size;
+    struct aec_stream *strm = &state->strm;
+
+    for (;;) {
+        n = MIN(MIN(state->line_fill, state->line_size) - state->line_pos,
+                *avail);
+        memcpy(*dest, state->line + state->line_pos, n);
+        *dest += n;
+        *avail -= n;
+        state->line_pos += n;
+        if (*avail == 0)
+            return AEC_OK;
+
+        if (state->line_fill == state->rsi_size
+            || (direct && state->line_pos == state->line_fill))
+            state->line_fill = state->line_pos = 0;
+
+        if (direct && state->line_fill == 0
+            && *avail >= (size_t)state->pixel_size) {
+            n = *avail - *avail % state->pixel_size;
+            strm->next_out = *dest;
+            strm->avail_out = n;
+            status = aec_decode(strm, AEC_NO_FLUSH);
+            if (status != AEC_OK)
+                return status;
+            *dest = strm->next_out;
+            *avail -= n - strm->avail_out;
+            if (strm->avail_out > 0)
+                return AEC_OK;
+            continue;
+        }
+
+        strm->next_out = state->line + state->line_fill;
+        strm->avail_out = state->rsi_size - state->line_fill;
+        status = aec_decode(strm, AEC_NO_FLUSH);
+        if (status != AEC_OK)
+            return status;
+        n = state->rsi_size - state->line_fill - strm->avail_out;
+        if (n == 0)
+            return AEC_OK;
+        state->line_fill += n;
+    }
+}
+
+static void stream_free(struct sz_internal_state *state)
+{
+    free(state->line);
+    free(state->planes);
+    free(state);
+}
+
+static int stream_init(sz_stream *strm, int encode)
+{
+    int status;
+    struct sz_internal_state *state;
+    struct aec_stream *aec;
+
+    if (strm->pixels_per_block <= 0 || strm->pixels_per_scanline <= 0)
+        return SZ_PARAM_ERROR;
+
+    state = calloc(1, sizeof(struct sz_internal_state));
+    if (state == NULL)
+        return SZ_MEM_ERROR;
+
+    aec = &state->strm;
+    aec->block_size = strm->pixels_per_block;
+    aec->rsi = (strm->pixels_per_scanline + strm->pixels_per_block - 1)
+        / strm->pixels_per_block;
+    aec->flags = convert_options(strm->options_mask);
+    if (encode)
+        aec->flags |= AEC_NOT_ENFORCE;
+
+    if (strm->bits_per_pixel == 32 || strm->bits_per_pixel == 64) {
+        state->wordsize = strm->bits_per_pixel / 8;
+        aec->bits_per_sample = 8;
+    } else {
+        aec->bits_per_sample = strm->bits_per_pixel;
+    }
+    state->pixel_size = bits_to_bytes(aec->bits_per_sample);
+    state->line_size = (size_t)strm->pixels_per_scanline * state->pixel_size;
+    state->rsi_size = (size_t)aec->rsi * aec->block_size * state->pixel_size;
+    state->image_size = strm->image_pixels
+        * (state->wordsize? state->wordsize: state->pixel_size);
+
+    if (state->image_size == 0 && (state->wordsize || !encode)) {
+        free(state);
+        return SZ_PARAM_ERROR;
+    }
+
+    status = encode? aec_encode_init(aec): aec_decode_init(aec);
+    if (status != AEC_OK) {
+        free(state);
+        return status;
+    }
+
+    state->line = malloc(state->rsi_size);
+    if (state->line == NULL)
+        status = SZ_MEM_ERROR;
+    if (state->wordsize) {
+        state->planes = malloc(state->image_size);
+        if (state->planes == NULL)
+            status = SZ_MEM_ERROR;
+    }
+    if (status != SZ_OK) {
+        if (encode)
+            aec_encode_end(aec);
+        else
+            aec_decode_end(aec);
+        stream_free(state);
+        return status;
+    }
+
+    strm->total_in = 0;
+    strm->total_out = 0;
+    strm->state = state;
+    return SZ_OK;
+}
+
+int SZ_CompressInit(sz_stream *strm)
+{
+    return stream_init(strm, 1);
+}
+
+int SZ_Compress(sz_stream *strm, int flush)
+{
+    /**
+       Byte planes can only be encoded once the whole image is in.
+    */
+
+    int status;
+    int finish = flush == SZ_FINISH;
+    struct sz_internal_state *state = strm->state;
+    const unsigned char *src;
+    size_t n, avail;
+
+    src = strm->next_in;
+    avail = strm->avail_in;
+
+    if (state->planes) {
+        n = MIN(avail, state->image_size - state->image_pos);
+        interleave_bytes(state, src, n);
+        strm->next_in += n;
+        strm->avail_in -= n;
+        strm->total_in += n;
+        if (state->image_pos < state->image_size)
+            return finish? SZ_STREAM_ERROR: SZ_OK;
+        src = state->planes + state->planes_coded;
+        avail = state->image_size - state->planes_coded;
+    }
+
+    state->strm.next_out = strm->next_out;
+    state->strm.avail_out = strm->avail_out;
+    status = encode_lines(state, &src, &avail, finish);
+    strm->next_out = state->strm.next_out;
+    strm->avail_out = state->strm.avail_out;
+    strm->total_out = state->strm.total_out;
+
+    if (state->planes) {
+        state->planes_coded = state->image_size - avail;
+    } else {
+        strm->total_in += strm->avail_in - avail;
+        strm->next_in = src;
+        strm->avail_in = avail;
+    }
+    return status;
+}
+
+int SZ_CompressEnd(sz_stream *strm)
+{
+    int status;
+
+    status = aec_encode_end(&strm->state->strm);
+    stream_free(strm->state);
+    strm->state = NULL;
+    return status;
+}
+
+int SZ_DecompressInit(sz_stream *strm)
+{
+    return stream_init(strm, 0);
+}
+
+int SZ_Decompress(sz_stream *strm, int flush)
+{
+    /**
+       Byte planes can only be joined to pixels once the whole image
+       is decoded.
+    */
+
+    int status;
+    struct sz_internal_state *state = strm->state;
+    unsigned char *dest;
+    size_t n, avail;
+
+    (void)flush;
+    state->strm.next_in = strm->next_in;
+    state->strm.avail_in = strm->avail_in;
+    status = AEC_OK;
+
+    if (state->planes) {
+        if (state->planes_coded < state->image_size) {
+            dest = state->planes + state->planes_coded;
+            avail = state->image_size - state->planes_coded;
+            status = decode_lines(state, &dest, &avail);
+            state->planes_coded = state->image_size - avail;
+        }
+        if (state->planes_coded == state->image_size) {
+            n = MIN(strm->avail_out, state->image_size - state->image_pos);
+            deinterleave_bytes(state, strm->next_out, n);
+            strm->next_out += n;
+            strm->avail_out -= n;
+            strm->total_out += n;
+        }
+    } else {
+        dest = strm->next_out;
+        avail = MIN(strm->avail_out, state->image_size - state->image_pos);
+        n = avail;
+        status = decode_lines(state, &dest, &avail);
+        n -= avail;
+        state->image_pos += n;
+        strm->next_out += n;
+        strm->avail_out -= n;
+        strm->total_out += n;
+    }
+
+    strm->total_in += strm->avail_in - state->strm.avail_in;
+    strm->next_in = state->strm.next_in;
+    strm->avail_in = state->strm.avail_in;
+
+    if (status != AEC_OK)
+        return status;
+    if (state->image_pos == state->image_size)
+        return SZ_STREAM_END;
+    return SZ_OK;
+}
+
+int SZ_DecompressEnd(sz_stream *strm)
+{
+    int status;
+
+    status = aec_decode_end(&strm->state->strm);
+    stream_free(strm->state);
+    strm->state = NULL;
+    return status;
+}
@@ -0,0 +1,401 @@
+/**
+ * @file sz_simd.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Vectorized byte plane transposes for the SZIP compatibility library
+ * with runtime dispatch
+ *
+ */
+
+#include <config.h>
+#include "sz_simd.h"
+
+#if HAVE_SSSE3 || HAVE_AVX2
+#  include <immintrin.h>
+#endif
+
+#if HAVE_SSSE3 || HAVE_AVX2
+/* Gather byte j of each word into group j of a 128 bit lane */
+static const unsigned char gather_4[16] = {
+    0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15
+};
+
+static const unsigned char gather_8[16] = {
+    0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15
+};
+#endif
+
+#if HAVE_SSSE3
+__attribute__((target("ssse3")))
+static size_t interleave_4_ssse3(unsigned char *dest,
+                                 const unsigned char *src, size_t n,
+                                 size_t stride)
+{
+    /**
+       A shuffle gathers the bytes of four words by plane, a 4 x 4
+       transpose of 32 bit elements then collects 16 bytes of each
+       plane in one vector.
+    */
+
+    size_t i;
+    int k;
+    __m128i a[4], t[4];
+    const __m128i shuf = _mm_loadu_si128((const __m128i *)gather_4);
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        for (k = 0; k < 4; k++)
+            a[k] = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i *)(src + 4 * i + 16 * k)),
+                shuf);
+        t[0] = _mm_unpacklo_epi32(a[0], a[1]);
+        t[1] = _mm_unpackhi_epi32(a[0], a[1]);
+        t[2] = _mm_unpacklo_epi32(a[2], a[3]);
+        t[3] = _mm_unpackhi_epi32(a[2], a[3]);
+        _mm_storeu_si128((__m128i *)(dest + i),
+                         _mm_unpacklo_epi64(t[0], t[2]));
+        _mm_storeu_si128((__m128i *)(dest + stride + i),
+                         _mm_unpackhi_epi64(t[0], t[2]));
+        _mm_storeu_si128((__m128i *)(dest + 2 * stride + i),
+                         _mm_unpacklo_epi64(t[1], t[3]));
+        _mm_storeu_si128((__m128i *)(dest + 3 * stride + i),
+                         _mm_unpackhi_epi64(t[1], t[3]));
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static size_t interleave_8_ssse3(unsigned char *dest,
+                                 const unsigned char *src, size_t n,
+                                 size_t stride)
+{
+    /**
+       A shuffle gathers the bytes of two words by plane, an 8 x 8
+       transpose of 16 bit elements then collects 16 bytes of each
+       plane in one vector.
+    */
+
+    size_t i;
+    int k;
+    __m128i a[8], b[8];
+    const __m128i shuf = _mm_loadu_si128((const __m128i *)gather_8);
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        for (k = 0; k < 8; k++)
+            a[k] = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i *)(src + 8 * i + 16 * k)),
+                shuf);
+        for (k = 0; k < 8; k += 2) {
+            b[k] = _mm_unpacklo_epi16(a[k], a[k + 1]);
+            b[k + 1] = _mm_unpackhi_epi16(a[k], a[k + 1]);
+        }
+        for (k = 0; k < 8; k += 4) {
+            a[k] = _mm_unpacklo_epi32(b[k], b[k + 2]);
+            a[k + 1] = _mm_unpackhi_epi32(b[k], b[k + 2]);
+            a[k + 2] = _mm_unpacklo_epi32(b[k + 1], b[k + 3]);
+            a[k + 3] = _mm_unpackhi_epi32(b[k + 1], b[k + 3]);
+        }
+        for (k = 0; k < 4; k++) {
+            _mm_storeu_si128((__m128i *)(dest + 2 * k * stride + i),
+                             _mm_unpacklo_epi64(a[k], a[k + 4]));
+            _mm_storeu_si128((__m128i *)(dest + (2 * k + 1) * stride + i),
+                             _mm_unpackhi_epi64(a[k], a[k + 4]));
+        }
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static size_t deinterleave_4_ssse3(unsigned char *dest,
+                                   const unsigned char *src, size_t n,
+                                   size_t stride)
+{
+    size_t i;
+    __m128i p[4], b[4];
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        p[0] = _mm_loadu_si128((const __m128i *)(src + i));
+        p[1] = _mm_loadu_si128((const __m128i *)(src + stride + i));
+        p[2] = _mm_loadu_si128((const __m128i *)(src + 2 * stride + i));
+        p[3] = _mm_loadu_si128((const __m128i *)(src + 3 * stride + i));
+        b[0] = _mm_unpacklo_epi8(p[0], p[1]);
+        b[1] = _mm_unpackhi_epi8(p[0], p[1]);
+        b[2] = _mm_unpacklo_epi8(p[2], p[3]);
+        b[3] = _mm_unpackhi_epi8(p[2], p[3]);
+        _mm_storeu_si128((__m128i *)(dest + 4 * i),
+                         _mm_unpacklo_epi16(b[0], b[2]));
+        _mm_storeu_si128((__m128i *)(dest + 4 * i + 16),
+                         _mm_unpackhi_epi16(b[0], b[2]));
+        _mm_storeu_si128((__m128i *)(dest + 4 * i + 32),
+                         _mm_unpacklo_epi16(b[1], b[3]));
+        _mm_storeu_si128((__m128i *)(dest + 4 * i + 48),
+                         _mm_unpackhi_epi16(b[1], b[3]));
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static size_t deinterleave_8_ssse3(unsigned char *dest,
+                                   const unsigned char *src, size_t n,
+                                   size_t stride)
+{
+    size_t i;
+    int k;
+    __m128i p[8], b[8];
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        for (k = 0; k < 8; k++)
+            p[k] = _mm_loadu_si128((const __m128i *)(src + k * stride + i));
+        for (k = 0; k < 8; k += 2) {
+            b[k] = _mm_unpacklo_epi8(p[k], p[k + 1]);
+            b[k + 1] = _mm_unpackhi_epi8(p[k], p[k + 1]);
+        }
+        for (k = 0; k < 8; k += 4) {
+            p[k] = _mm_unpacklo_epi16(b[k], b[k + 2]);
+            p[k + 1] = _mm_unpackhi_epi16(b[k], b[k + 2]);
+            p[k + 2] = _mm_unpacklo_epi16(b[k + 1], b[k + 3]);
+            p[k + 3] = _mm_unpackhi_epi16(b[k + 1], b[k + 3]);
+        }
+        for (k = 0; k < 4; k++) {
+            _mm_storeu_si128((__m128i *)(dest + 8 * i + 32 * k),
+                             _mm_unpacklo_epi32(p[k], p[k + 4]));
+            _mm_storeu_si128((__m128i *)(dest + 8 * i + 32 * k + 16),
+                             _mm_unpackhi_epi32(p[k], p[k + 4]));
+        }
+    }
+    return i;
+}
+#endif /* HAVE_SSSE3 */
+
+#if HAVE_AVX2
+__attribute__((target("avx2")))
+static size_t interleave_4_avx2(unsigned char *dest,
+                                const unsigned char *src, size_t n,
+                                size_t stride)
+{
+    /**
+       Same as the SSSE3 kernel on both 128 bit lanes. The words are
+       first distributed over the lanes such that the lower lanes hold
+       the first and the upper lanes the second 16 words.
+    */
+
+    size_t i;
+    int k;
+    __m256i v[4], a[4], t[4];
+    const __m256i shuf = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)gather_4));
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        for (k = 0; k < 4; k++)
+            v[k] = _mm256_loadu_si256(
+                (const __m256i *)(src + 4 * i + 32 * k));
+        for (k = 0; k < 2; k++) {
+            a[2 * k] = _mm256_shuffle_epi8(
+                _mm256_permute2x128_si256(v[k], v[k + 2], 0x20), shuf);
+            a[2 * k + 1] = _mm256_shuffle_epi8(
+                _mm256_permute2x128_si256(v[k], v[k + 2], 0x31), shuf);
+        }
+        t[0] = _mm256_unpacklo_epi32(a[0], a[1]);
+        t[1] = _mm256_unpackhi_epi32(a[0], a[1]);
+        t[2] = _mm256_unpacklo_epi32(a[2], a[3]);
+        t[3] = _mm256_unpackhi_epi32(a[2], a[3]);
+        _mm256_storeu_si256((__m256i *)(dest + i),
+                            _mm256_unpacklo_epi64(t[0], t[2]));
+        _mm256_storeu_si256((__m256i *)(dest + stride + i),
+                            _mm256_unpackhi_epi64(t[0], t[2]));
+        _mm256_storeu_si256((__m256i *)(dest + 2 * stride + i),
+                            _mm256_unpacklo_epi64(t[1], t[3]));
+        _mm256_storeu_si256((__m256i *)(dest + 3 * stride + i),
+                            _mm256_unpackhi_epi64(t[1], t[3]));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t interleave_8_avx2(unsigned char *dest,
+                                const unsigned char *src, size_t n,
+                                size_t stride)
+{
+    size_t i;
+    int k;
+    __m256i v[8], a[8], b[8];
+    const __m256i shuf = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)gather_8));
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        for (k = 0; k < 8; k++)
+            v[k] = _mm256_loadu_si256(
+                (const __m256i *)(src + 8 * i + 32 * k));
+        for (k = 0; k < 4; k++) {
+            a[2 * k] = _mm256_shuffle_epi8(
+                _mm256_permute2x128_si256(v[k], v[k + 4], 0x20), shuf);
+            a[2 * k + 1] = _mm256_shuffle_epi8(
+                _mm256_permute2x128_si256(v[k], v[k + 4], 0x31), shuf);
+        }
+        for (k = 0; k < 8; k += 2) {
+            b[k] = _mm256_unpacklo_epi16(a[k], a[k + 1]);
+            b[k + 1] = _mm256_unpackhi_epi16(a[k], a[k + 1]);
+        }
+        for (k = 0; k < 8; k += 4) {
+            a[k] = _mm256_unpacklo_epi32(b[k], b[k + 2]);
+            a[k + 1] = _mm256_unpackhi_epi32(b[k], b[k + 2]);
+            a[k + 2] = _mm256_unpacklo_epi32(b[k + 1], b[k + 3]);
+            a[k + 3] = _mm256_unpackhi_epi32(b[k + 1], b[k + 3]);
+        }
+        for (k = 0; k < 4; k++) {
+            _mm256_storeu_si256((__m256i *)(dest + 2 * k * stride + i),
+                                _mm256_unpacklo_epi64(a[k], a[k + 4]));
+            _mm256_storeu_si256(
+                (__m256i *)(dest + (2 * k + 1) * stride + i),
+                _mm256_unpackhi_epi64(a[k], a[k + 4]));
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t deinterleave_4_avx2(unsigned char *dest,
+                                  const unsigned char *src, size_t n,
+                                  size_t stride)
+{
+    /**
+       The unpacks work within 128 bit lanes, so the lower lanes
+       produce the first and the upper lanes the second 16 words.
+       Lane permutations put the words back in order.
+    */
+
+    size_t i;
+    int k;
+    __m256i p[4], b[4];
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        for (k = 0; k < 4; k++)
+            p[k] = _mm256_loadu_si256(
+                (const __m256i *)(src + k * stride + i));
+        b[0] = _mm256_unpacklo_epi8(p[0], p[1]);
+        b[1] = _mm256_unpackhi_epi8(p[0], p[1]);
+        b[2] = _mm256_unpacklo_epi8(p[2], p[3]);
+        b[3] = _mm256_unpackhi_epi8(p[2], p[3]);
+        p[0] = _mm256_unpacklo_epi16(b[0], b[2]);
+        p[1] = _mm256_unpackhi_epi16(b[0], b[2]);
+        p[2] = _mm256_unpacklo_epi16(b[1], b[3]);
+        p[3] = _mm256_unpackhi_epi16(b[1], b[3]);
+        for (k = 0; k < 2; k++) {
+            _mm256_storeu_si256(
+                (__m256i *)(dest + 4 * i + 32 * k),
+                _mm256_permute2x128_si256(p[2 * k], p[2 * k + 1], 0x20));
+            _mm256_storeu_si256(
+                (__m256i *)(dest + 4 * i + 32 * k + 64),
+                _mm256_permute2x128_si256(p[2 * k], p[2 * k + 1], 0x31));
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t deinterleave_8_avx2(unsigned char *dest,
+                                  const unsigned char *src, size_t n,
+                                  size_t stride)
+{
+    size_t i;
+    int k;
+    __m256i p[8], b[8];
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        for (k = 0; k < 8; k++)
+            p[k] = _mm256_loadu_si256(
+                (const __m256i *)(src + k * stride + i));
+        for (k = 0; k < 8; k += 2) {
+            b[k] = _mm256_unpacklo_epi8(p[k], p[k + 1]);
+            b[k + 1] = _mm256_unpackhi_epi8(p[k], p[k + 1]);
+        }
+        for (k = 0; k < 8; k += 4) {
+            p[k] = _mm256_unpacklo_epi16(b[k], b[k + 2]);
+            p[k + 1] = _mm256_unpackhi_epi16(b[k], b[k + 2]);
+            p[k + 2] = _mm256_unpacklo_epi16(b[k + 1], b[k + 3]);
+            p[k + 3] = _mm256_unpackhi_epi16(b[k + 1], b[k + 3]);
+        }
+        for (k = 0; k < 4; k++) {
+            b[2 * k] = _mm256_unpacklo_epi32(p[k], p[k + 4]);
+            b[2 * k + 1] = _mm256_unpackhi_epi32(p[k], p[k + 4]);
+        }
+        for (k = 0; k < 4; k++) {
+            _mm256_storeu_si256(
+                (__m256i *)(dest + 8 * i + 32 * k),
+                _mm256_permute2x128_si256(b[2 * k], b[2 * k + 1], 0x20));
+            _mm256_storeu_si256(
+                (__m256i *)(dest + 8 * i + 32 * k + 128),
+                _mm256_permute2x128_si256(b[2 * k], b[2 * k + 1], 0x31));
+        }
+    }
+    return i;
+}
+#endif /* HAVE_AVX2 */
+
+sz_transpose_t sz_select_interleave(int wordsize)
+{
+#if HAVE_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        return wordsize == 4? interleave_4_avx2: interleave_8_avx2;
+#endif
+#if HAVE_SSSE3
+    if (__builtin_cpu_supports("ssse3"))
+        return wordsize == 4? interleave_4_ssse3: interleave_8_ssse3;
+#endif
+    (void)wordsize;
+    return NULL;
+}
+
+sz_transpose_t sz_select_deinterleave(int wordsize)
+{
+#if HAVE_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        return wordsize == 4? deinterleave_4_avx2: deinterleave_8_avx2;
+#endif
+#if HAVE_SSSE3
+    if (__builtin_cpu_supports("ssse3"))
+        return wordsize == 4? deinterleave_4_ssse3: deinterleave_8_ssse3;
+#endif
+    (void)wordsize;
+    return NULL;
+}
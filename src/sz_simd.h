@@ -0,0 +1,71 @@
+/**
+ * @file sz_simd.h
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Vectorized byte plane transposes for the SZIP compatibility library
+ *
+ */
+
+#ifndef SZ_SIMD_H
+#define SZ_SIMD_H 1
+
+#include <config.h>
+#include <stddef.h>
+
+/* Transpose between n words of wordsize bytes and wordsize byte
+ * planes which start stride bytes apart. An interleave kernel moves
+ * byte j of word i from src[i * wordsize + j] to dest[j * stride + i],
+ * a deinterleave kernel does the reverse. Words are handled from the
+ * start as far as full vectors reach. Returns the number of words
+ * done, the rest is left to the scalar code. */
+typedef size_t (*sz_transpose_t)(unsigned char *dest,
+                                 const unsigned char *src, size_t n,
+                                 size_t stride);
+
+/* Return the fastest kernel supported by the CPU for words of the
+ * given size or NULL if the scalar code should be used */
+sz_transpose_t sz_select_interleave(int wordsize);
+sz_transpose_t sz_select_deinterleave(int wordsize);
+
+#endif /* SZ_SIMD_H */
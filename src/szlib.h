@@ -12,11 +12,17 @@
 #define SZ_RAW_OPTION_MASK             128
 
 #define SZ_OK AEC_OK
+#define SZ_STREAM_END 1
 #define SZ_OUTBUFF_FULL 2
 
+#define SZ_NO_FLUSH 0
+#define SZ_FINISH 4
+
 #define SZ_NO_ENCODER_ERROR -1
 #define SZ_PARAM_ERROR AEC_CONF_ERROR
 #define SZ_MEM_ERROR AEC_MEM_ERROR
+#define SZ_STREAM_ERROR AEC_STREAM_ERROR
+#define SZ_DATA_ERROR AEC_DATA_ERROR
 
 #define SZ_MAX_PIXELS_PER_BLOCK 32
 #define SZ_MAX_BLOCKS_PER_SCANLINE 128
@@ -42,4 +48,52 @@ LIBAEC_DLL_EXPORTED int SZ_BufftoBuffDecompress(
 
 LIBAEC_DLL_EXPORTED int SZ_encoder_enabled(void);
 
+struct sz_internal_state;
+
+/* Stream for incremental compression and decompression. Set the
+ * parameters and call SZ_CompressInit() or SZ_DecompressInit(), then
+ * provide input and output space with next_in, avail_in, next_out
+ * and avail_out and call SZ_Compress() or SZ_Decompress() until it
+ * returns SZ_STREAM_END.
+ *
+ * Scanlines are padded and unpadded one at a time, so memory use is
+ * of the order of a scanline. Pixels of 32 and 64 bit are split into
+ * byte planes which span the whole image. For them a buffer of
+ * image_pixels words is needed. */
+typedef struct sz_stream_s
+{
+    const unsigned char *next_in;
+    size_t avail_in;
+    size_t total_in;
+    unsigned char *next_out;
+    size_t avail_out;
+    size_t total_out;
+
+    int options_mask;
+    int bits_per_pixel;
+    int pixels_per_block;
+    int pixels_per_scanline;
+
+    /* Number of pixels of the whole image. Required for decompression
+     * and for compression of 32 and 64 bit pixels. */
+    size_t image_pixels;
+
+    struct sz_internal_state *state;
+} sz_stream;
+
+/* SZ_Compress() consumes as much input as possible. With SZ_FINISH
+ * all output is drained and SZ_STREAM_END is returned once the
+ * stream is complete. Otherwise call again with more output
+ * space. */
+LIBAEC_DLL_EXPORTED int SZ_CompressInit(sz_stream *strm);
+LIBAEC_DLL_EXPORTED int SZ_Compress(sz_stream *strm, int flush);
+LIBAEC_DLL_EXPORTED int SZ_CompressEnd(sz_stream *strm);
+
+/* SZ_Decompress() returns SZ_STREAM_END once image_pixels have been
+ * written. The flush argument is accepted for symmetry and
+ * ignored. */
+LIBAEC_DLL_EXPORTED int SZ_DecompressInit(sz_stream *strm);
+LIBAEC_DLL_EXPORTED int SZ_Decompress(sz_stream *strm, int flush);
+LIBAEC_DLL_EXPORTED int SZ_DecompressEnd(sz_stream *strm);
+
 #endif /* SZLIB_H */
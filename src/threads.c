@@ -0,0 +1,548 @@
+/**
+ * @file threads.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Run independent jobs on a set of worker threads
+ *
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#if HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif
+
+#include "libaec.h"
+#include "threads.h"
+
+struct job_queue {
+    void (*job)(void *arg, size_t n);
+    void *arg;
+
+    /* total number of jobs */
+    size_t njobs;
+
+    /* next job to be handed out */
+    size_t next;
+
+#if HAVE_PTHREAD_H
+    pthread_mutex_t lock;
+#endif
+};
+
+static int take_job(struct job_queue *queue, size_t *n)
+{
+    int avail;
+
+#if HAVE_PTHREAD_H
+    pthread_mutex_lock(&queue->lock);
+#endif
+    avail = queue->next < queue->njobs;
+    if (avail)
+        *n = queue->next++;
+#if HAVE_PTHREAD_H
+    pthread_mutex_unlock(&queue->lock);
+#endif
+    return avail;
+}
+
+static void *run_jobs(void *arg)
+{
+    size_t n;
+    struct job_queue *queue = arg;
+
+    while (take_job(queue, &n))
+        queue->job(queue->arg, n);
+
+    return NULL;
+}
+
+static void spawn_for(int nthreads, size_t njobs,
+                      void (*job)(void *arg, size_t n), void *arg)
+{
+    /**
+       Run jobs on threads which are started for this call only.
+     */
+
+    struct job_queue queue;
+#if HAVE_PTHREAD_H
+    pthread_t *threads;
+    int i, nstarted;
+#endif
+
+    queue.job = job;
+    queue.arg = arg;
+    queue.njobs = njobs;
+    queue.next = 0;
+
+#if HAVE_PTHREAD_H
+    if ((size_t)nthreads > njobs)
+        nthreads = (int)njobs;
+
+    threads = NULL;
+    if (nthreads > 1)
+        threads = malloc((nthreads - 1) * sizeof(pthread_t));
+
+    pthread_mutex_init(&queue.lock, NULL);
+
+    /* If threads can't be created, the remaining jobs are done by
+     * the threads we already have. */
+    nstarted = 0;
+    for (i = 0; threads && i < nthreads - 1; i++) {
+        if (pthread_create(&threads[i], NULL, run_jobs, &queue))
+            break;
+        nstarted++;
+    }
+
+    run_jobs(&queue);
+
+    for (i = 0; i < nstarted; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_mutex_destroy(&queue.lock);
+    free(threads);
+#else
+    (void)nthreads;
+    run_jobs(&queue);
+#endif
+}
+
+#if HAVE_PTHREAD_H
+
+/* Jobs of one call to aec_parallel_for() with a pool */
+struct pool_batch {
+    void (*job)(void *arg, size_t n);
+    void *arg;
+
+    /* jobs not yet finished */
+    size_t remaining;
+};
+
+/* Consecutive jobs [begin, end) of a batch */
+struct pool_task {
+    struct pool_batch *batch;
+    size_t begin;
+    size_t end;
+};
+
+/* Tasks of one worker. The owner takes jobs from the bottom, other
+ * threads steal half of the task at the top. */
+struct pool_deque {
+    pthread_mutex_t lock;
+    struct pool_task *tasks;
+
+    /* index of top task and number of tasks */
+    size_t top;
+    size_t size;
+    size_t capacity;
+};
+
+struct aec_pool {
+    int nworkers;
+    pthread_t *threads;
+    struct pool_deque *deques;
+
+    /* protects all following members */
+    pthread_mutex_t lock;
+
+    /* signaled when jobs were added or the pool shuts down */
+    pthread_cond_t work;
+
+    /* signaled when a batch is finished */
+    pthread_cond_t done;
+
+    /* jobs added but not yet taken. May be negative for a moment
+     * because jobs are added before they are counted. */
+    long unclaimed;
+
+    /* worker which gets the first task of the next batch */
+    int next_worker;
+
+    int shutdown;
+};
+
+struct pool_worker {
+    struct aec_pool *pool;
+    int id;
+};
+
+static int push_task(struct pool_deque *deque, struct pool_task task)
+{
+    struct pool_task *tasks;
+    size_t i, capacity;
+
+    pthread_mutex_lock(&deque->lock);
+    if (deque->size == deque->capacity) {
+        capacity = deque->capacity ? 2 * deque->capacity : 16;
+        tasks = malloc(capacity * sizeof(struct pool_task));
+        if (tasks == NULL) {
+            pthread_mutex_unlock(&deque->lock);
+            return -1;
+        }
+        for (i = 0; i < deque->size; i++)
+            tasks[i] = deque->tasks[(deque->top + i) % deque->capacity];
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->top = 0;
+        deque->capacity = capacity;
+    }
+    deque->tasks[(deque->top + deque->size) % deque->capacity] = task;
+    deque->size++;
+    pthread_mutex_unlock(&deque->lock);
+    return 0;
+}
+
+static int pop_job(struct pool_deque *deque, struct pool_task *job)
+{
+    /**
+       Take the first job of the bottom task.
+     */
+
+    struct pool_task *task;
+    int avail;
+
+    pthread_mutex_lock(&deque->lock);
+    avail = deque->size > 0;
+    if (avail) {
+        task = &deque->tasks[(deque->top + deque->size - 1)
+                             % deque->capacity];
+        job->batch = task->batch;
+        job->begin = task->begin++;
+        job->end = task->begin;
+        if (task->begin == task->end)
+            deque->size--;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return avail;
+}
+
+static int steal_task(struct pool_deque *deque, struct pool_task *stolen,
+                      size_t max)
+{
+    /**
+       Take the upper half of the jobs of the top task, at most max.
+     */
+
+    struct pool_task *task;
+    size_t n;
+    int avail;
+
+    pthread_mutex_lock(&deque->lock);
+    avail = deque->size > 0;
+    if (avail) {
+        task = &deque->tasks[deque->top];
+        n = (task->end - task->begin + 1) / 2;
+        if (n > max)
+            n = max;
+        *stolen = *task;
+        stolen->begin = task->end - n;
+        task->end = stolen->begin;
+        if (task->begin == task->end) {
+            deque->top = (deque->top + 1) % deque->capacity;
+            deque->size--;
+        }
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return avail;
+}
+
+static int find_task(struct aec_pool *pool, int id, struct pool_task *task)
+{
+    /**
+       Take a job from the deque of worker id or steal some. Stolen
+       jobs beyond the first go to the deque of worker id if
+       possible. The calling thread of aec_parallel_for() has no
+       deque (id < 0) and steals single jobs.
+     */
+
+    struct pool_task rest;
+    int i, victim;
+
+    if (id >= 0 && pop_job(&pool->deques[id], task))
+        goto CLAIM;
+
+    for (i = 1; i <= pool->nworkers; i++) {
+        victim = (id + i + pool->nworkers) % pool->nworkers;
+        if (victim == id)
+            continue;
+        if (steal_task(&pool->deques[victim], task,
+                       id < 0 ? 1 : (size_t)-1)) {
+            rest = *task;
+            rest.begin++;
+            if (rest.begin < rest.end
+                && push_task(&pool->deques[id], rest) == 0)
+                task->end = rest.begin;
+            goto CLAIM;
+        }
+    }
+    return 0;
+
+CLAIM:
+    pthread_mutex_lock(&pool->lock);
+    pool->unclaimed -= (long)(task->end - task->begin);
+    pthread_mutex_unlock(&pool->lock);
+    return 1;
+}
+
+static void run_task(struct aec_pool *pool, struct pool_task *task)
+{
+    size_t n;
+
+    for (n = task->begin; n < task->end; n++)
+        task->batch->job(task->batch->arg, n);
+
+    pthread_mutex_lock(&pool->lock);
+    task->batch->remaining -= task->end - task->begin;
+    if (task->batch->remaining == 0)
+        pthread_cond_broadcast(&pool->done);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void *worker_main(void *arg)
+{
+    struct pool_worker *worker = arg;
+    struct aec_pool *pool = worker->pool;
+    struct pool_task task;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->unclaimed <= 0 && !pool->shutdown)
+            pthread_cond_wait(&pool->work, &pool->lock);
+        if (pool->shutdown && pool->unclaimed <= 0) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        while (find_task(pool, worker->id, &task))
+            run_task(pool, &task);
+    }
+    free(worker);
+    return NULL;
+}
+
+static void pool_for(struct aec_pool *pool, size_t njobs,
+                     void (*job)(void *arg, size_t n), void *arg)
+{
+    /**
+       Spread the jobs over the deques of all workers in slices of
+       consecutive jobs, then help until all of them are finished.
+     */
+
+    struct pool_batch batch;
+    struct pool_task task;
+    size_t slice, queued;
+    int w;
+
+    batch.job = job;
+    batch.arg = arg;
+    batch.remaining = njobs;
+
+    pthread_mutex_lock(&pool->lock);
+    w = pool->next_worker;
+    pool->next_worker = (w + 1) % pool->nworkers;
+    pthread_mutex_unlock(&pool->lock);
+
+    slice = (njobs + pool->nworkers - 1) / pool->nworkers;
+    queued = 0;
+    task.batch = &batch;
+    for (task.begin = 0; task.begin < njobs; task.begin = task.end) {
+        task.end = task.begin + slice < njobs ? task.begin + slice : njobs;
+        if (push_task(&pool->deques[w], task))
+            break;
+        queued = task.end;
+        w = (w + 1) % pool->nworkers;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->unclaimed += (long)queued;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    /* Jobs which could not be queued are done here */
+    if (queued < njobs) {
+        task.begin = queued;
+        task.end = njobs;
+        run_task(pool, &task);
+    }
+
+    for (;;) {
+        if (find_task(pool, -1, &task)) {
+            run_task(pool, &task);
+            continue;
+        }
+        pthread_mutex_lock(&pool->lock);
+        if (batch.remaining == 0) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        if (pool->unclaimed <= 0)
+            pthread_cond_wait(&pool->done, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+struct aec_pool *aec_pool_create(int nthreads)
+{
+    struct aec_pool *pool;
+    struct pool_worker *worker;
+    int i;
+
+    if (nthreads < 1)
+        return NULL;
+
+    pool = calloc(1, sizeof(struct aec_pool));
+    if (pool == NULL)
+        return NULL;
+
+    pool->threads = malloc(nthreads * sizeof(pthread_t));
+    pool->deques = calloc(nthreads, sizeof(struct pool_deque));
+    if (pool->threads == NULL || pool->deques == NULL) {
+        free(pool->threads);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    /* A pool which could not start all workers works with fewer.
+     * Workers wait for the lock before they look at nworkers. */
+    pthread_mutex_lock(&pool->lock);
+    for (i = 0; i < nthreads; i++) {
+        worker = malloc(sizeof(struct pool_worker));
+        if (worker == NULL)
+            break;
+        worker->pool = pool;
+        worker->id = i;
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        if (pthread_create(&pool->threads[i], NULL, worker_main, worker)) {
+            pthread_mutex_destroy(&pool->deques[i].lock);
+            free(worker);
+            break;
+        }
+        pool->nworkers++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (pool->nworkers == 0) {
+        aec_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void aec_pool_destroy(struct aec_pool *pool)
+{
+    int i;
+
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->nworkers; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    for (i = 0; i < pool->nworkers; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->deques);
+    free(pool->threads);
+    free(pool);
+}
+
+int aec_thread_count(struct aec_pool *pool, int nthreads)
+{
+    if (pool == NULL)
+        return nthreads;
+    return pool->nworkers + 1;
+}
+
+#else /* HAVE_PTHREAD_H */
+
+struct aec_pool {
+    int nworkers;
+};
+
+struct aec_pool *aec_pool_create(int nthreads)
+{
+    (void)nthreads;
+    return NULL;
+}
+
+void aec_pool_destroy(struct aec_pool *pool)
+{
+    (void)pool;
+}
+
+int aec_thread_count(struct aec_pool *pool, int nthreads)
+{
+    return pool == NULL ? nthreads : 1;
+}
+
+#endif /* HAVE_PTHREAD_H */
+
+void aec_parallel_for(struct aec_pool *pool, int nthreads, size_t njobs,
+                      void (*job)(void *arg, size_t n), void *arg)
+{
+#if HAVE_PTHREAD_H
+    if (pool != NULL) {
+        pool_for(pool, njobs, job, arg);
+        return;
+    }
+#endif
+    spawn_for(nthreads, njobs, job, arg);
+}
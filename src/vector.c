@@ -0,0 +1,116 @@
+/**
+ * @file vector.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Growable array of offsets
+ *
+ */
+
+#include <config.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "vector.h"
+
+#define VECTOR_INITIAL_CAPACITY 128
+
+struct vector_t *vector_create(const struct aec_allocator *alloc)
+{
+    struct vector_t *vec = aec_alloc(alloc, sizeof(struct vector_t));
+    if (vec == NULL)
+        return NULL;
+
+    vec->size = 0;
+    vec->capacity = VECTOR_INITIAL_CAPACITY;
+    vec->values = aec_alloc(alloc, vec->capacity * sizeof(size_t));
+    if (vec->values == NULL) {
+        aec_free(alloc, vec);
+        return NULL;
+    }
+    return vec;
+}
+
+void vector_destroy(const struct aec_allocator *alloc,
+                    struct vector_t *vec)
+{
+    if (vec == NULL)
+        return;
+    aec_free(alloc, vec->values);
+    aec_free(alloc, vec);
+}
+
+int vector_push_back(const struct aec_allocator *alloc,
+                     struct vector_t *vec, size_t value)
+{
+    size_t *values;
+
+    if (vec->size == vec->capacity) {
+        /* No realloc with user supplied functions */
+        values = aec_alloc(alloc, 2 * vec->capacity * sizeof(size_t));
+        if (values == NULL)
+            return -1;
+        memcpy(values, vec->values, vec->size * sizeof(size_t));
+        aec_free(alloc, vec->values);
+        vec->values = values;
+        vec->capacity *= 2;
+    }
+    vec->values[vec->size++] = value;
+    return 0;
+}
+
+void vector_clear(struct vector_t *vec)
+{
+    if (vec != NULL)
+        vec->size = 0;
+}
+
+size_t vector_size(const struct vector_t *vec)
+{
+    return vec->size;
+}
+
+size_t *vector_data(const struct vector_t *vec)
+{
+    return vec->values;
+}
@@ -56,6 +56,49 @@ int update_state(struct test_state *state)
     return 0;
 }
 
+void fill_random_walk(struct test_state *state, unsigned int seed,
+                      int step, size_t period)
+{
+    /**
+       Fill ubuf with a random walk of steps up to +-step which
+       starts in the middle of the range. With period > 0 the walk
+       alternates with regions of period samples of uniform noise,
+       constant samples and steps 32 times as large, so that all code
+       options get used.
+    */
+
+    size_t i, n;
+    long long int x, range;
+    int size = state->bytes_per_sample;
+
+    n = state->buf_len / size;
+    range = state->xmax - state->xmin;
+    x = state->xmin + range / 2;
+    srand(seed);
+
+    for (i = 0; i < n; i++) {
+        switch (period? (i / period) % 4: 0) {
+        case 0:
+            x += rand() % (2 * step + 1) - step;
+            break;
+        case 1:
+            x = state->xmin + (long long int)((double)rand() / RAND_MAX
+                                              * range);
+            break;
+        case 2:
+            break;
+        default:
+            x += 32 * (rand() % (2 * step + 1) - step);
+            break;
+        }
+        if (x > state->xmax)
+            x = state->xmax;
+        if (x < state->xmin)
+            x = state->xmin;
+        state->out(state->ubuf + i * size, x, size);
+    }
+}
+
 int encode_decode_small(struct test_state *state)
 {
     int status, i;
@@ -19,6 +19,8 @@ struct test_state {
 };
 
 int update_state(struct test_state *state);
+void fill_random_walk(struct test_state *state, unsigned int seed,
+                      int step, size_t period);
 int encode_decode_small(struct test_state *state);
 int encode_decode_large(struct test_state *state);
 
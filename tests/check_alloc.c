@@ -0,0 +1,368 @@
+/**
+ * @file check_alloc.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * User supplied memory management
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check_aec.h"
+
+/* Multiple of all sample sizes */
+#define BUF_SIZE (48 * 1024)
+
+struct alloc_count {
+    /* allocations not yet released */
+    long live;
+
+    /* allocations so far */
+    long calls;
+
+    /* zalloc fails if calls reaches limit (no limit if negative) */
+    long limit;
+};
+
+static void *count_alloc(void *opaque, size_t items, size_t size)
+{
+    struct alloc_count *count = opaque;
+
+    if (count->limit >= 0 && count->calls >= count->limit)
+        return NULL;
+    count->calls++;
+    count->live++;
+    return malloc(items * size);
+}
+
+static void count_free(void *opaque, void *address)
+{
+    struct alloc_count *count = opaque;
+
+    count->live--;
+    free(address);
+}
+
+static int check_leaks(struct alloc_count *count, const char *what)
+{
+    if (count->calls == 0) {
+        printf("\n%s: %s did not use zalloc.\n", CHECK_FAIL, what);
+        return 99;
+    }
+    if (count->live != 0) {
+        printf("\n%s: %s leaked %li allocations.\n",
+               CHECK_FAIL, what, count->live);
+        return 99;
+    }
+    return 0;
+}
+
+static int check_switch(struct aec_stream *strm, struct alloc_count *count,
+                        int decode)
+{
+    /**
+       Memory has to be released with the functions it was allocated
+       with, even if the stream switches them before a reset or the
+       end.
+    */
+
+    int status;
+    struct aec_stream s = *strm;
+    const char *what = decode? "Decoder": "Encoder";
+
+    count->limit = -1;
+    count->calls = 0;
+    s.flags |= AEC_CUSTOM_ALLOC;
+    status = decode? aec_decode_init(&s): aec_encode_init(&s);
+    if (status == AEC_OK)
+        status = decode? aec_decode_enable_stats(&s)
+            : aec_encode_enable_offsets(&s);
+    if (status != AEC_OK) {
+        printf("%s init failed (%i).\n", what, status);
+        return 99;
+    }
+
+    /* Rebuilt without custom allocation */
+    s.flags &= ~AEC_CUSTOM_ALLOC;
+    status = decode? aec_decode_reset(&s): aec_encode_reset(&s);
+    if (status != AEC_OK) {
+        printf("%s reset failed (%i).\n", what, status);
+        return 99;
+    }
+    if (count->live != 0) {
+        printf("\n%s: %s reset did not release memory with zfree.\n",
+               CHECK_FAIL, what);
+        return 99;
+    }
+
+    /* Rebuilt with custom allocation, then released after opaque
+     * changed */
+    s.flags |= AEC_CUSTOM_ALLOC;
+    status = decode? aec_decode_reset(&s): aec_encode_reset(&s);
+    if (status == AEC_OK)
+        status = decode? aec_decode_enable_stats(&s)
+            : aec_encode_enable_stats(&s);
+    if (status != AEC_OK) {
+        printf("%s reset failed (%i).\n", what, status);
+        return 99;
+    }
+    s.opaque = NULL;
+    s.flags &= ~AEC_CUSTOM_ALLOC;
+    if (decode)
+        aec_decode_end(&s);
+    else
+        aec_encode_end(&s);
+    return check_leaks(count, what);
+}
+
+static int check_alloc(struct test_state *state)
+{
+    int status;
+    size_t clen, noffsets;
+    size_t *offsets;
+    struct aec_stream *strm = state->strm;
+    struct aec_stream ref, dec;
+    struct alloc_count count;
+
+    /* Reference without custom allocation */
+    ref = *strm;
+    ref.next_in = state->ubuf;
+    ref.avail_in = state->buf_len;
+    ref.next_out = state->cbuf;
+    ref.avail_out = state->cbuf_len;
+    if (aec_buffer_encode(&ref) != AEC_OK) {
+        printf("Encode failed.\n");
+        return 99;
+    }
+    clen = ref.total_out;
+
+    memset(&count, 0, sizeof(count));
+    count.limit = -1;
+    strm->flags |= AEC_CUSTOM_ALLOC;
+    strm->zalloc = count_alloc;
+    strm->zfree = count_free;
+    strm->opaque = &count;
+
+    strm->next_in = state->ubuf;
+    strm->avail_in = state->buf_len;
+    strm->next_out = state->obuf;
+    strm->avail_out = state->cbuf_len;
+    status = aec_encode_init(strm);
+    if (status == AEC_OK)
+        status = aec_encode_enable_offsets(strm);
+    if (status == AEC_OK)
+        status = aec_encode(strm, AEC_FLUSH);
+    if (status == AEC_OK)
+        status = aec_encode_count_offsets(strm, &noffsets);
+    if (status != AEC_OK) {
+        printf("Encode failed (%i).\n", status);
+        return 99;
+    }
+    offsets = malloc(noffsets * sizeof(size_t));
+    if (offsets == NULL) {
+        printf("Not enough memory.\n");
+        return 99;
+    }
+    aec_encode_get_offsets(strm, offsets, noffsets);
+    aec_encode_end(strm);
+    if (strm->total_out != clen || memcmp(state->cbuf, state->obuf, clen)) {
+        printf("\n%s: Encoded output differs.\n", CHECK_FAIL);
+        free(offsets);
+        return 99;
+    }
+    if ((status = check_leaks(&count, "Encoder")))
+        goto EXIT;
+
+    count.calls = 0;
+    strm->next_in = state->cbuf;
+    strm->avail_in = clen;
+    status = aec_decode_init(strm);
+    if (status == AEC_OK) {
+        status = aec_decode_scan_offsets(strm);
+        aec_decode_end(strm);
+    }
+    if (status != AEC_OK) {
+        printf("Scanning offsets failed (%i).\n", status);
+        goto EXIT;
+    }
+    if ((status = check_leaks(&count, "Scanning offsets")))
+        goto EXIT;
+
+    count.calls = 0;
+    dec = *strm;
+    dec.next_in = state->cbuf;
+    dec.avail_in = clen;
+    dec.next_out = state->obuf;
+    dec.avail_out = state->buf_len;
+    status = aec_buffer_decode(&dec);
+    if (status != AEC_OK) {
+        printf("Decode failed (%i).\n", status);
+        goto EXIT;
+    }
+    if (dec.total_out != state->buf_len
+        || memcmp(state->ubuf, state->obuf, state->buf_len)) {
+        printf("\n%s: Decoded output differs.\n", CHECK_FAIL);
+        status = 99;
+        goto EXIT;
+    }
+    if ((status = check_leaks(&count, "Decoder")))
+        goto EXIT;
+
+    count.calls = 0;
+    dec = *strm;
+    dec.next_in = state->cbuf;
+    dec.avail_in = clen;
+    dec.next_out = state->obuf;
+    dec.avail_out = state->buf_len / 2;
+    status = aec_decode_init(&dec);
+    if (status == AEC_OK) {
+        status = aec_decode_range(&dec, offsets, noffsets,
+                                  state->buf_len / 4, state->buf_len / 2);
+        aec_decode_end(&dec);
+    }
+    if (status != AEC_OK) {
+        printf("Range decode failed (%i).\n", status);
+        goto EXIT;
+    }
+    if (memcmp(state->ubuf + state->buf_len / 4, state->obuf,
+               state->buf_len / 2)) {
+        printf("\n%s: Decoded range differs.\n", CHECK_FAIL);
+        status = 99;
+        goto EXIT;
+    }
+    if ((status = check_leaks(&count, "Range decoder")))
+        goto EXIT;
+
+    /* Every failing allocation has to be reported and must not
+     * leak. */
+    count.limit = 0;
+    count.calls = 0;
+    while (count.limit < 8) {
+        dec = *strm;
+        dec.next_in = state->cbuf;
+        dec.avail_in = clen;
+        dec.next_out = state->obuf;
+        dec.avail_out = state->buf_len;
+        status = aec_buffer_decode(&dec);
+        if (status == AEC_OK)
+            break;
+        if (status != AEC_MEM_ERROR || count.live != 0) {
+            printf("\n%s: Failing allocation %li not handled.\n",
+                   CHECK_FAIL, count.limit);
+            status = 99;
+            goto EXIT;
+        }
+        count.limit++;
+        count.calls = 0;
+    }
+    if (status != AEC_OK) {
+        printf("\n%s: Decoder needs too many allocations.\n", CHECK_FAIL);
+        status = 99;
+        goto EXIT;
+    }
+
+    if ((status = check_switch(strm, &count, 0)))
+        goto EXIT;
+    status = check_switch(strm, &count, 1);
+
+EXIT:
+    strm->flags &= ~AEC_CUSTOM_ALLOC;
+    free(offsets);
+    return status;
+}
+
+int main(void)
+{
+    int status, bps;
+    unsigned int flags[] = {
+        AEC_DATA_PREPROCESS,
+        AEC_DATA_PREPROCESS | AEC_DATA_SIGNED | AEC_PAD_RSI,
+    };
+    size_t i;
+    struct aec_stream strm;
+    struct test_state state;
+
+    state.buf_len = state.ibuf_len = BUF_SIZE;
+    state.cbuf_len = 2 * BUF_SIZE;
+
+    state.ubuf = (unsigned char *)malloc(state.buf_len);
+    state.cbuf = (unsigned char *)malloc(state.cbuf_len);
+    state.obuf = (unsigned char *)malloc(state.cbuf_len);
+
+    if (!state.ubuf || !state.cbuf || !state.obuf) {
+        printf("Not enough memory.\n");
+        return 99;
+    }
+
+    state.strm = &strm;
+    status = 0;
+
+    for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        for (bps = 8; bps <= 32; bps += 8) {
+            strm.bits_per_sample = bps;
+            strm.block_size = 16;
+            strm.rsi = 32;
+            strm.flags = flags[i];
+            if (bps == 24)
+                strm.flags |= AEC_DATA_3BYTE;
+            update_state(&state);
+            fill_random_walk(&state, 13, 64, 0);
+
+            printf("Checking custom allocation with %2i bit, flags %3u ... ",
+                   bps, strm.flags);
+            status = check_alloc(&state);
+            if (status)
+                goto DESTRUCT;
+            printf("%s\n", CHECK_PASS);
+        }
+    }
+
+DESTRUCT:
+    free(state.ubuf);
+    free(state.cbuf);
+    free(state.obuf);
+
+    return status;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file check_batch.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Coding of many independent buffers in one call
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check_aec.h"
+
+/* Multiple of all sample sizes */
+#define BUF_SIZE (96 * 1024)
+#define NBUFFERS 37
+
+static size_t buffer_len(struct test_state *state, size_t n)
+{
+    /* Buffers of different length, not all of them whole RSIs */
+    size_t len = state->buf_len / NBUFFERS - n * 23;
+
+    return len - len % state->bytes_per_sample;
+}
+
+static int check_batch(struct test_state *state, int nthreads)
+{
+    int status;
+    size_t n, pos, cpos, len;
+    struct aec_stream *strm = state->strm;
+    struct aec_buffer enc[NBUFFERS], dec[NBUFFERS];
+    size_t clen[NBUFFERS];
+
+    /* Reference: every buffer on its own */
+    pos = cpos = 0;
+    for (n = 0; n < NBUFFERS; n++) {
+        len = buffer_len(state, n);
+        strm->next_in = state->ubuf + pos;
+        strm->avail_in = len;
+        strm->next_out = state->cbuf + cpos;
+        strm->avail_out = state->cbuf_len / NBUFFERS;
+        if (aec_buffer_encode(strm) != AEC_OK) {
+            printf("Encode failed.\n");
+            return 99;
+        }
+        clen[n] = strm->total_out;
+
+        enc[n].next_in = state->ubuf + pos;
+        enc[n].avail_in = len;
+        enc[n].next_out = state->obuf + cpos;
+        enc[n].avail_out = state->cbuf_len / NBUFFERS;
+        pos += len;
+        cpos += state->cbuf_len / NBUFFERS;
+    }
+
+    /* Too little space for one of them */
+    enc[3].avail_out = clen[3] / 2;
+
+    status = aec_buffer_encode_batch(strm, enc, NBUFFERS, nthreads);
+    if (status != AEC_STREAM_ERROR || enc[3].status != AEC_STREAM_ERROR) {
+        printf("\n%s: Unexpected status %i of batch encoding.\n",
+               CHECK_FAIL, status);
+        return 99;
+    }
+
+    cpos = 0;
+    for (n = 0; n < NBUFFERS; n++) {
+        if (n != 3 && (enc[n].status != AEC_OK
+                       || enc[n].total_out != clen[n]
+                       || memcmp(state->cbuf + cpos, state->obuf + cpos,
+                                 clen[n]))) {
+            printf("\n%s: Batch encoding of buffer %lu differs.\n",
+                   CHECK_FAIL, (unsigned long)n);
+            return 99;
+        }
+        cpos += state->cbuf_len / NBUFFERS;
+    }
+
+    pos = cpos = 0;
+    for (n = 0; n < NBUFFERS; n++) {
+        len = buffer_len(state, n);
+        dec[n].next_in = state->cbuf + cpos;
+        dec[n].avail_in = clen[n];
+        dec[n].next_out = state->obuf + pos;
+        dec[n].avail_out = len;
+        pos += len;
+        cpos += state->cbuf_len / NBUFFERS;
+    }
+
+    status = aec_buffer_decode_batch(strm, dec, NBUFFERS, nthreads);
+    if (status != AEC_OK) {
+        printf("Batch decoding failed (%i).\n", status);
+        return 99;
+    }
+
+    for (n = 0; n < NBUFFERS; n++) {
+        if (dec[n].total_out != buffer_len(state, n)) {
+            printf("\n%s: Batch decoding of buffer %lu is incomplete.\n",
+                   CHECK_FAIL, (unsigned long)n);
+            return 99;
+        }
+    }
+    if (memcmp(state->ubuf, state->obuf, pos)) {
+        printf("\n%s: Batch decoded output differs.\n", CHECK_FAIL);
+        return 99;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    int status, bps, nthreads;
+    unsigned int flags[] = {
+        0,
+        AEC_DATA_PREPROCESS,
+        AEC_DATA_PREPROCESS | AEC_DATA_SIGNED | AEC_PAD_RSI,
+        AEC_DATA_PREPROCESS | AEC_DATA_MSB
+    };
+    size_t i;
+    struct aec_stream strm;
+    struct test_state state;
+
+    state.buf_len = state.ibuf_len = BUF_SIZE;
+    state.cbuf_len = 2 * BUF_SIZE;
+
+    state.ubuf = (unsigned char *)malloc(state.buf_len);
+    state.cbuf = (unsigned char *)malloc(state.cbuf_len);
+    state.obuf = (unsigned char *)malloc(state.cbuf_len);
+
+    if (!state.ubuf || !state.cbuf || !state.obuf) {
+        printf("Not enough memory.\n");
+        return 99;
+    }
+
+    state.strm = &strm;
+    status = 0;
+
+    for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        for (bps = 8; bps <= 32; bps += 8) {
+            strm.bits_per_sample = bps;
+            strm.block_size = 16;
+            strm.rsi = 32;
+            strm.flags = flags[i];
+            if (bps == 24)
+                strm.flags |= AEC_DATA_3BYTE;
+            update_state(&state);
+            fill_random_walk(&state, 17, 16, 512);
+
+            for (nthreads = 1; nthreads <= 4; nthreads += 3) {
+                printf("Checking batch coding with %2i bit, flags %3u, "
+                       "%i threads ... ", bps, strm.flags, nthreads);
+                status = check_batch(&state, nthreads);
+                if (status)
+                    goto DESTRUCT;
+                printf("%s\n", CHECK_PASS);
+            }
+        }
+    }
+
+DESTRUCT:
+    free(state.ubuf);
+    free(state.cbuf);
+    free(state.obuf);
+
+    return status;
+}
@@ -0,0 +1,201 @@
+/**
+ * @file check_datagen.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Check that the synthetic data is coded with the intended options
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check_aec.h"
+#include "datagen.h"
+
+/* Multiple of all sample sizes */
+#define BUF_SIZE (96 * 1024)
+
+static unsigned char ubuf[BUF_SIZE];
+static unsigned char cbuf[2 * BUF_SIZE];
+static unsigned char obuf[BUF_SIZE];
+
+static int code(struct datagen *gen, double *bits_per_sample)
+{
+    /**
+       Round trip the data of gen and return the coded bits per
+       sample.
+    */
+
+    int status;
+    size_t len;
+    struct aec_stream strm;
+
+    len = datagen_fill(gen, ubuf, BUF_SIZE);
+
+    strm.bits_per_sample = gen->bits_per_sample;
+    strm.block_size = gen->block_size;
+    strm.rsi = gen->rsi;
+    strm.flags = gen->flags;
+    strm.next_in = ubuf;
+    strm.avail_in = len;
+    strm.next_out = cbuf;
+    strm.avail_out = sizeof(cbuf);
+    status = aec_buffer_encode(&strm);
+    if (status != AEC_OK) {
+        printf("Encoding failed (%i).\n", status);
+        return 99;
+    }
+    *bits_per_sample = strm.total_out * 8.0
+        / (len / datagen_sample_size(gen));
+
+    strm.next_in = cbuf;
+    strm.avail_in = strm.total_out;
+    strm.next_out = obuf;
+    strm.avail_out = len;
+    status = aec_buffer_decode(&strm);
+    if (status != AEC_OK) {
+        printf("Decoding failed (%i).\n", status);
+        return 99;
+    }
+    if (strm.total_out != len || memcmp(ubuf, obuf, len)) {
+        printf("\n%s: Round trip of %s data failed.\n", CHECK_FAIL,
+               datagen_model_name(gen->model));
+        return 1;
+    }
+    return 0;
+}
+
+static int check_options(struct datagen *gen)
+{
+    /**
+       Data made for one code option has to compress as that option
+       does.
+    */
+
+    int status, k, kmax;
+    double bits, bps = gen->bits_per_sample;
+
+    gen->model = DATAGEN_OPTIONS;
+
+    gen->options = DATAGEN_ZERO_BLOCK;
+    gen->zero_run = 64;
+    if ((status = code(gen, &bits)))
+        return status;
+    if (bits > 0.1) {
+        printf("\n%s: %.3f bits per sample for zero blocks.\n",
+               CHECK_FAIL, bits);
+        return 1;
+    }
+
+    gen->options = DATAGEN_SE;
+    if ((status = code(gen, &bits)))
+        return status;
+    if (bits > 1.0) {
+        printf("\n%s: %.3f bits per sample for second extension.\n",
+               CHECK_FAIL, bits);
+        return 1;
+    }
+
+    gen->options = DATAGEN_UNCOMP;
+    if ((status = code(gen, &bits)))
+        return status;
+    if (bits < bps) {
+        printf("\n%s: %.3f bits per sample for uncompressed blocks.\n",
+               CHECK_FAIL, bits);
+        return 1;
+    }
+
+    /* A split block with k has about k + 1.5 bits per sample plus the
+     * option ID */
+    gen->options = DATAGEN_SPLIT;
+    kmax = bps > 16? 29: bps > 8? 13: 5;
+    for (k = 1; k <= kmax && k < bps - 1; k++) {
+        gen->k_min = gen->k_max = k;
+        if ((status = code(gen, &bits)))
+            return status;
+        if (bits < k + 1.2 || bits > k + 2.0) {
+            printf("\n%s: %.3f bits per sample for k = %i.\n",
+                   CHECK_FAIL, bits, k);
+            return 1;
+        }
+    }
+
+    gen->options = DATAGEN_ALL;
+    gen->k_min = 1;
+    gen->k_max = kmax;
+    gen->zero_run = 3;
+    return code(gen, &bits);
+}
+
+int main(void)
+{
+    int status, i;
+    unsigned int bps, flags[] = {
+        AEC_DATA_PREPROCESS,
+        AEC_DATA_PREPROCESS | AEC_DATA_SIGNED,
+        AEC_DATA_PREPROCESS | AEC_DATA_SIGNED | AEC_DATA_MSB,
+        AEC_DATA_PREPROCESS | AEC_DATA_3BYTE,
+        0
+    };
+    struct datagen gen;
+    double bits;
+
+    for (i = 0; i < (int)(sizeof(flags) / sizeof(flags[0])); i++) {
+        for (bps = 1; bps <= 32; bps++) {
+            if (flags[i] & AEC_DATA_3BYTE && (bps < 17 || bps > 24))
+                continue;
+            printf("Checking data for %2u bit, flags %2u ... ",
+                   bps, flags[i]);
+            datagen_init(&gen, bps, 16, 128, flags[i]);
+            for (gen.model = DATAGEN_SMOOTH; gen.model < DATAGEN_OPTIONS;
+                 gen.model++)
+                if ((status = code(&gen, &bits)))
+                    return status;
+            if (bps >= 8 && (status = check_options(&gen)))
+                return status;
+            printf("%s\n", CHECK_PASS);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check_aec.h"
+
+#define BUF_SIZE (3 * 64 * 1024)
+#define NRANGES 200
+
+static int check_range(struct test_state *state,
+                       size_t *offsets, size_t count, size_t len,
+                       size_t pos, size_t size)
+{
+    int status;
+    struct aec_stream *strm = state->strm;
+
+    strm->next_out = state->obuf;
+    strm->avail_out = size;
+    status = aec_decode_range(strm, offsets, count, pos, size);
+    if (status != AEC_OK) {
+        printf("Range decode failed (%i).\n", status);
+        return 99;
+    }
+
+    if (strm->next_in != state->cbuf || strm->avail_in != len
+        || strm->next_out != state->obuf + size) {
+        printf("\n%s: Unexpected stream state after range decode.\n",
+               CHECK_FAIL);
+        return 99;
+    }
+
+    if (memcmp(state->ubuf + pos, state->obuf, size)) {
+        printf("\n%s: Range [%lu, %lu) differs from input.\n", CHECK_FAIL,
+               (unsigned long)pos, (unsigned long)(pos + size));
+        return 99;
+    }
+    return 0;
+}
+
+static int check_scan(struct test_state *state,
+                      size_t *offsets, size_t count)
+{
+    size_t scan_count;
+    size_t *scan_offsets;
+    struct aec_stream *strm = state->strm;
+
+    if (aec_decode_scan_offsets(strm) != AEC_OK
+        || aec_decode_count_offsets(strm, &scan_count) != AEC_OK) {
+        printf("Scan failed.\n");
+        return 99;
+    }
+
+    if (scan_count != count) {
+        printf("\n%s: Scan found %lu RSIs, expected %lu.\n", CHECK_FAIL,
+               (unsigned long)scan_count, (unsigned long)count);
+        return 99;
+    }
+
+    scan_offsets = malloc(count * sizeof(size_t));
+    if (scan_offsets == NULL) {
+        printf("Not enough memory.\n");
+        return 99;
+    }
+    aec_decode_get_offsets(strm, scan_offsets, count);
+    if (memcmp(offsets, scan_offsets, count * sizeof(size_t))) {
+        printf("\n%s: Scanned offsets differ from encoder offsets.\n",
+               CHECK_FAIL);
+        free(scan_offsets);
+        return 99;
+    }
+    free(scan_offsets);
+    return 0;
+}
+
+static int check_seek(struct test_state *state,
+                      size_t *offsets, size_t count, size_t len)
+{
+    /* Seek a decoder which stopped in the middle of an RSI. */
+    int status;
+    size_t r, rsi_bytes, size;
+    struct aec_stream *strm = state->strm;
+
+    rsi_bytes = strm->rsi * strm->block_size * state->bytes_per_sample;
+    for (r = count; r-- > 0;) {
+        strm->next_in = state->cbuf;
+        strm->avail_in = len;
+        status = aec_buffer_seek(strm, offsets[r]);
+        if (status != AEC_OK) {
+            printf("Seek failed (%i).\n", status);
+            return 99;
+        }
+
+        size = state->ibuf_len - r * rsi_bytes;
+        if (size > rsi_bytes)
+            size = rsi_bytes;
+        if (size > state->bytes_per_sample)
+            size -= state->bytes_per_sample;
+        strm->next_out = state->obuf;
+        strm->avail_out = size;
+        status = aec_decode(strm, AEC_NO_FLUSH);
+        if (status != AEC_OK) {
+            printf("Decode after seek failed (%i).\n", status);
+            return 99;
+        }
+
+        if (strm->avail_out != 0
+            || memcmp(state->ubuf + r * rsi_bytes, state->obuf, size)) {
+            printf("\n%s: RSI %lu differs from input after seek.\n",
+                   CHECK_FAIL, (unsigned long)r);
+            return 99;
+        }
+    }
+    strm->next_in = state->cbuf;
+    strm->avail_in = len;
+    return 0;
+}
+
+static int check_ranges(struct test_state *state)
+{
+    int status, i;
+    size_t len, count, nsamples, pos, size;
+    size_t *offsets;
+    struct aec_stream *strm = state->strm;
+
+    strm->next_in = state->ubuf;
+    strm->avail_in = state->ibuf_len;
+    strm->next_out = state->cbuf;
+    strm->avail_out = state->cbuf_len;
+
+    if (aec_encode_init(strm) != AEC_OK
+        || aec_encode_enable_offsets(strm) != AEC_OK
+        || aec_encode(strm, AEC_FLUSH) != AEC_OK
+        || aec_encode_count_offsets(strm, &count) != AEC_OK) {
+        printf("Encode failed.\n");
+        return 99;
+    }
+    len = strm->total_out;
+
+    offsets = malloc(count * sizeof(size_t));
+    if (offsets == NULL) {
+        printf("Not enough memory.\n");
+        return 99;
+    }
+    aec_encode_get_offsets(strm, offsets, count);
+    aec_encode_end(strm);
+
+    strm->next_in = state->cbuf;
+    strm->avail_in = len;
+    if (aec_decode_init(strm) != AEC_OK) {
+        printf("Init failed.\n");
+        free(offsets);
+        return 99;
+    }
+
+    status = check_scan(state, offsets, count);
+    if (status == 0)
+        status = check_seek(state, offsets, count, len);
+    if (status) {
+        aec_decode_end(strm);
+        free(offsets);
+        return status;
+    }
+
+    nsamples = state->ibuf_len / state->bytes_per_sample;
+    for (i = 0; i < NRANGES && status == 0; i++) {
+        pos = rand() % nsamples;
+        size = rand() % (nsamples - pos) % 5000;
+        status = check_range(state, offsets, count, len,
+                             pos * state->bytes_per_sample,
+                             size * state->bytes_per_sample);
+    }
+
+    /* whole buffer and last sample */
+    if (status == 0)
+        status = check_range(state, offsets, count, len,
+                             0, state->ibuf_len);
+    if (status == 0)
+        status = check_range(state, offsets, count, len,
+                             state->ibuf_len - state->bytes_per_sample,
+                             state->bytes_per_sample);
+
+    aec_decode_end(strm);
+    free(offsets);
+    return status;
+}
+
+int main(void)
+{
+    int status, bps;
+    unsigned int flags[] = {
+        0,
+        AEC_DATA_PREPROCESS,
+        AEC_DATA_PREPROCESS | AEC_DATA_SIGNED,
+        AEC_DATA_PREPROCESS | AEC_DATA_MSB | AEC_PAD_RSI
+    };
+    unsigned int rsi[] = {1, 3, 128};
+    size_t i, j, k;
+    struct aec_stream strm;
+    struct test_state state;
+
+    state.buf_len = state.ibuf_len = BUF_SIZE;
+    state.cbuf_len = 2 * BUF_SIZE;
+
+    state.ubuf = (unsigned char *)malloc(state.buf_len);
+    state.cbuf = (unsigned char *)malloc(state.cbuf_len);
+    state.obuf = (unsigned char *)malloc(state.buf_len);
+
+    if (!state.ubuf || !state.cbuf || !state.obuf) {
+        printf("Not enough memory.\n");
+        return 99;
+    }
+
+    state.strm = &strm;
+    strm.block_size = 16;
+    status = 0;
+
+    for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        for (bps = 8; bps <= 32; bps += 8) {
+            strm.bits_per_sample = bps;
+            strm.flags = flags[i];
+            if (bps == 24)
+                strm.flags |= AEC_DATA_3BYTE;
+            update_state(&state);
+            fill_random_walk(&state, 7, 127, 1000);
+
+            printf("Checking scanning and range decoding with %2i bit, flags %2u ... ",
+                   bps, strm.flags);
+            for (j = 0; j < sizeof(rsi) / sizeof(rsi[0]); j++) {
+                strm.rsi = rsi[j];
+                for (k = 0; k < 3; k++) {
+                    /* complete and incomplete last RSI */
+                    state.ibuf_len = state.buf_len
+                        - k * 7 * state.bytes_per_sample;
+                    status = check_ranges(&state);
+                    if (status)
+                        goto DESTRUCT;
+                }
+            }
+            printf("%s\n", CHECK_PASS);
+        }
+    }
+
+DESTRUCT:
+    free(state.ubuf);
+    free(state.cbuf);
+    free(state.obuf);
+
+    return status;
+}
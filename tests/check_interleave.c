@@ -0,0 +1,196 @@
+/**
+ * @file check_interleave.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Check the byte plane interleaving of 32 and 64 bit SZIP pixels
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check_aec.h"
+#include "szlib.h"
+
+#define MAX_WORDS 20000
+
+static void fill_buffer(unsigned char *buf, size_t n, int wordsize)
+{
+    /**
+       Slowly varying words with noise in the low order bytes like
+       floating point data.
+    */
+
+    size_t i;
+    int j;
+    unsigned long long x = 0x4045000000000000ULL;
+
+    srand(37);
+    for (i = 0; i < n; i++) {
+        x += (unsigned long long)(rand() % 4096) << (8 * wordsize - 28);
+        x ^= (unsigned long long)rand();
+        for (j = 0; j < wordsize; j++)
+            buf[i * wordsize + j] =
+                (unsigned char)(x >> (8 * (wordsize - 1 - j)));
+    }
+}
+
+static int check_interleave(const unsigned char *src, size_t n,
+                            SZ_com_t *param)
+{
+    /**
+       Compare SZ_BufftoBuffCompress() with encoding the byte planes
+       of a reference transpose and check the round trip.
+    */
+
+    int status;
+    size_t i, len, clen, dlen, out_len;
+    int j, wordsize = param->bits_per_pixel / 8;
+    unsigned char *planes, *ref, *cbuf, *dbuf;
+    struct aec_stream strm;
+
+    len = n * wordsize;
+    out_len = 2 * len + 1024;
+    planes = malloc(len);
+    ref = malloc(out_len);
+    cbuf = malloc(out_len);
+    dbuf = malloc(len);
+    status = 99;
+    if (!planes || !ref || !cbuf || !dbuf) {
+        printf("Not enough memory.\n");
+        goto EXIT;
+    }
+
+    for (i = 0; i < n; i++)
+        for (j = 0; j < wordsize; j++)
+            planes[j * n + i] = src[i * wordsize + j];
+
+    strm.bits_per_sample = 8;
+    strm.block_size = param->pixels_per_block;
+    strm.rsi = (param->pixels_per_scanline + param->pixels_per_block - 1)
+        / param->pixels_per_block;
+    strm.flags = AEC_NOT_ENFORCE | AEC_DATA_PREPROCESS;
+    strm.next_in = planes;
+    strm.avail_in = len;
+    strm.next_out = ref;
+    strm.avail_out = out_len;
+    if (aec_buffer_encode_lines(&strm, param->pixels_per_scanline)
+        != AEC_OK) {
+        printf("Reference encoding failed.\n");
+        goto EXIT;
+    }
+
+    clen = out_len;
+    if (SZ_BufftoBuffCompress(cbuf, &clen, src, len, param) != SZ_OK) {
+        printf("Compression failed.\n");
+        goto EXIT;
+    }
+    if (clen != strm.total_out || memcmp(cbuf, ref, clen)) {
+        printf("\n%s: Compressed output for %lu words differs.\n",
+               CHECK_FAIL, (unsigned long)n);
+        status = 1;
+        goto EXIT;
+    }
+
+    dlen = len;
+    if (SZ_BufftoBuffDecompress(dbuf, &dlen, cbuf, clen, param) != SZ_OK) {
+        printf("Decompression failed.\n");
+        goto EXIT;
+    }
+    if (dlen != len || memcmp(dbuf, src, len)) {
+        printf("\n%s: Round trip of %lu words differs.\n",
+               CHECK_FAIL, (unsigned long)n);
+        status = 1;
+        goto EXIT;
+    }
+    status = 0;
+
+EXIT:
+    free(planes);
+    free(ref);
+    free(cbuf);
+    free(dbuf);
+    return status;
+}
+
+int main(void)
+{
+    int status, bpp;
+    size_t i, j;
+    size_t counts[] = {1, 15, 16, 17, 31, 32, 33, 63, 100, 1000, 4099,
+                       MAX_WORDS};
+    int scanlines[] = {256, 100};
+    unsigned char *src;
+    SZ_com_t param;
+
+    src = malloc(MAX_WORDS * 8);
+    if (!src) {
+        printf("Not enough memory.\n");
+        return 99;
+    }
+
+    status = 0;
+    param.options_mask = SZ_NN_OPTION_MASK | SZ_MSB_OPTION_MASK;
+    param.pixels_per_block = 16;
+
+    for (bpp = 32; bpp <= 64; bpp += 32) {
+        param.bits_per_pixel = bpp;
+        fill_buffer(src, MAX_WORDS, bpp / 8);
+        for (i = 0; i < sizeof(scanlines) / sizeof(scanlines[0]); i++) {
+            param.pixels_per_scanline = scanlines[i];
+            printf("Checking interleaving with %2i bit, scanline %3i ... ",
+                   bpp, scanlines[i]);
+            for (j = 0; j < sizeof(counts) / sizeof(counts[0]); j++) {
+                status = check_interleave(src, counts[j], &param);
+                if (status)
+                    goto DESTRUCT;
+            }
+            printf("%s\n", CHECK_PASS);
+        }
+    }
+
+DESTRUCT:
+    free(src);
+    return status;
+}
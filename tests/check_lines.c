@@ -0,0 +1,213 @@
+/**
+ * @file check_lines.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Encoding of input made of lines shorter than an RSI
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check_aec.h"
+
+#define BUF_SIZE (48 * 1024)
+
+static size_t pad_lines(struct test_state *state, unsigned char *dest,
+                        size_t len, size_t line_len)
+{
+    /**
+       Pad every line to a full RSI like SZ_BufftoBuffCompress() used
+       to.
+     */
+
+    struct aec_stream *strm = state->strm;
+    size_t i, j, k, ls, rsi_bytes;
+    int size = state->bytes_per_sample;
+    const unsigned char zero[4] = {0, 0, 0, 0};
+    const unsigned char *pixel;
+
+    rsi_bytes = strm->rsi * strm->block_size * size;
+    i = j = 0;
+    while (i < len) {
+        ls = line_len * size;
+        if (ls > len - i)
+            ls = len - i;
+        memcpy(dest + j, state->ubuf + i, ls);
+        i += ls;
+        pixel = strm->flags & AEC_DATA_PREPROCESS
+            ? state->ubuf + i - size : zero;
+        for (k = ls; k < rsi_bytes; k += size)
+            memcpy(dest + j + k, pixel, size);
+        j += rsi_bytes;
+    }
+    return j;
+}
+
+static int check_lines(struct test_state *state, size_t line_len)
+{
+    int status;
+    size_t len, padded_len, buf_len, clen, out_len;
+    unsigned char *padded, *cbuf, *obuf;
+    struct aec_stream *strm = state->strm;
+
+    /* A few lines with a short last one */
+    len = (line_len * 5 + line_len / 2 + 1) * state->bytes_per_sample;
+    if (len > state->buf_len)
+        len = state->buf_len;
+    buf_len = ((len / state->bytes_per_sample) / line_len + 1)
+        * strm->rsi * strm->block_size * 4;
+    padded = malloc(buf_len);
+    cbuf = malloc(2 * buf_len);
+    obuf = malloc(2 * buf_len);
+    status = 99;
+    if (!padded || !cbuf || !obuf) {
+        printf("Not enough memory.\n");
+        goto EXIT;
+    }
+    padded_len = pad_lines(state, padded, len, line_len);
+
+    strm->next_in = padded;
+    strm->avail_in = padded_len;
+    strm->next_out = cbuf;
+    strm->avail_out = 2 * buf_len;
+    if (aec_buffer_encode(strm) != AEC_OK) {
+        printf("Encode failed.\n");
+        goto EXIT;
+    }
+    clen = strm->total_out;
+
+    strm->next_in = state->ubuf;
+    strm->avail_in = len;
+    strm->next_out = obuf;
+    strm->avail_out = 2 * buf_len;
+    if (aec_buffer_encode_lines(strm, line_len) != AEC_OK) {
+        printf("Encoding lines failed.\n");
+        goto EXIT;
+    }
+    if (strm->total_out != clen || memcmp(cbuf, obuf, clen)) {
+        printf("\n%s: Output for lines of %lu samples differs.\n",
+               CHECK_FAIL, (unsigned long)line_len);
+        goto EXIT;
+    }
+
+    /* Decode all lines and, into a short buffer, part of them */
+    for (out_len = len; out_len > 0; out_len = out_len / 3
+             - out_len / 3 % state->bytes_per_sample) {
+        memset(padded, 0, buf_len);
+        strm->next_in = cbuf;
+        strm->avail_in = clen;
+        strm->next_out = padded;
+        strm->avail_out = out_len;
+        if (aec_buffer_decode_lines(strm, line_len) != AEC_OK) {
+            printf("Decoding lines failed.\n");
+            goto EXIT;
+        }
+        if (strm->total_out != out_len
+            || memcmp(padded, state->ubuf, out_len)
+            || padded[out_len] != 0) {
+            printf("\n%s: Decoding %lu bytes of lines of %lu samples "
+                   "failed.\n", CHECK_FAIL, (unsigned long)out_len,
+                   (unsigned long)line_len);
+            goto EXIT;
+        }
+    }
+    status = 0;
+
+EXIT:
+    free(padded);
+    free(cbuf);
+    free(obuf);
+    return status;
+}
+
+int main(void)
+{
+    int status, bps;
+    unsigned int flags[] = {
+        0,
+        AEC_DATA_PREPROCESS,
+        AEC_DATA_PREPROCESS | AEC_DATA_SIGNED | AEC_DATA_MSB
+    };
+    size_t line_lens[] = {1, 7, 100, 257, 512};
+    size_t i, j;
+    struct aec_stream strm;
+    struct test_state state;
+
+    state.buf_len = state.ibuf_len = BUF_SIZE;
+    state.ubuf = (unsigned char *)malloc(state.buf_len);
+
+    if (!state.ubuf) {
+        printf("Not enough memory.\n");
+        return 99;
+    }
+
+    state.strm = &strm;
+    status = 0;
+
+    for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        for (bps = 8; bps <= 32; bps += 8) {
+            strm.bits_per_sample = bps;
+            strm.block_size = 16;
+            strm.rsi = 32;
+            strm.flags = flags[i];
+            update_state(&state);
+            fill_random_walk(&state, 29, 16, 0);
+
+            printf("Checking lines with %2i bit, flags %3u ... ",
+                   bps, strm.flags);
+            for (j = 0; j < sizeof(line_lens) / sizeof(line_lens[0]); j++) {
+                status = check_lines(&state, line_lens[j]);
+                if (status)
+                    goto DESTRUCT;
+            }
+            printf("%s\n", CHECK_PASS);
+        }
+    }
+
+DESTRUCT:
+    free(state.ubuf);
+
+    return status;
+}
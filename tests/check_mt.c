@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check_aec.h"
+
+#define BUF_SIZE (3 * 256 * 1024)
+#define NTHREADS 4
+
+static int check_mt(struct test_state *state)
+{
+    int status;
+    size_t len, mt_len;
+    struct aec_stream *strm = state->strm;
+
+    strm->next_in = state->ubuf;
+    strm->avail_in = state->ibuf_len;
+    strm->next_out = state->cbuf;
+    strm->avail_out = state->cbuf_len;
+    status = aec_buffer_encode(strm);
+    if (status != AEC_OK) {
+        printf("Encode failed.\n");
+        return 99;
+    }
+    len = strm->total_out;
+
+    strm->next_in = state->ubuf;
+    strm->avail_in = state->ibuf_len;
+    strm->next_out = state->obuf;
+    strm->avail_out = state->cbuf_len;
+    status = aec_buffer_encode_mt(strm, NTHREADS);
+    if (status != AEC_OK) {
+        printf("Parallel encode failed.\n");
+        return 99;
+    }
+    mt_len = strm->total_out;
+
+    if (mt_len != len || memcmp(state->cbuf, state->obuf, len)) {
+        printf("\n%s: Parallel encoder output differs (%lu, %lu).\n",
+               CHECK_FAIL, (unsigned long)mt_len, (unsigned long)len);
+        return 99;
+    }
+
+    strm->next_in = state->cbuf;
+    strm->avail_in = len;
+    strm->next_out = state->obuf;
+    strm->avail_out = state->buf_len;
+    status = aec_buffer_decode(strm);
+    if (status != AEC_OK) {
+        printf("Decode failed.\n");
+        return 99;
+    }
+
+    if (memcmp(state->ubuf, state->obuf, state->ibuf_len)) {
+        printf("\n%s: Uncompressed output differs from input.\n",
+               CHECK_FAIL);
+        return 99;
+    }
+
+    /* Unaligned output can not be decoded in place */
+    strm->next_in = state->cbuf;
+    strm->avail_in = len;
+    strm->next_out = state->obuf + 1;
+    strm->avail_out = state->buf_len;
+    status = aec_buffer_decode(strm);
+    if (status != AEC_OK) {
+        printf("Decode failed.\n");
+        return 99;
+    }
+
+    if (memcmp(state->ubuf, state->obuf + 1, state->ibuf_len)) {
+        printf("\n%s: Unaligned output differs from input.\n",
+               CHECK_FAIL);
+        return 99;
+    }
+    return 0;
+}
+
+static int check_mt_decode(struct test_state *state)
+{
+    int status;
+    size_t len, count, nrsi, rsi_len;
+    size_t *offsets;
+    struct aec_stream *strm = state->strm;
+
+    strm->next_in = state->ubuf;
+    strm->avail_in = state->ibuf_len;
+    strm->next_out = state->cbuf;
+    strm->avail_out = state->cbuf_len;
+
+    if (aec_encode_init(strm) != AEC_OK
+        || aec_encode_enable_offsets(strm) != AEC_OK
+        || aec_encode(strm, AEC_FLUSH) != AEC_OK) {
+        printf("Encode failed.\n");
+        return 99;
+    }
+    len = strm->total_out;
+
+    if (aec_encode_count_offsets(strm, &count) != AEC_OK) {
+        printf("Counting offsets failed.\n");
+        return 99;
+    }
+
+    rsi_len = strm->rsi * strm->block_size * state->bytes_per_sample;
+    nrsi = (state->ibuf_len + rsi_len - 1) / rsi_len;
+    if (count != nrsi) {
+        printf("\n%s: Got %lu offsets, expected %lu.\n",
+               CHECK_FAIL, (unsigned long)count, (unsigned long)nrsi);
+        return 99;
+    }
+
+    offsets = malloc(count * sizeof(size_t));
+    if (offsets == NULL) {
+        printf("Not enough memory.\n");
+        return 99;
+    }
+    status = aec_encode_get_offsets(strm, offsets, count);
+    aec_encode_end(strm);
+    if (status != AEC_OK || offsets[0] != 0) {
+        printf("Getting offsets failed.\n");
+        free(offsets);
+        return 99;
+    }
+
+    strm->next_in = state->cbuf;
+    strm->avail_in = len;
+    strm->next_out = state->obuf;
+    strm->avail_out = state->buf_len;
+    status = aec_buffer_decode_mt(strm, offsets, count, NTHREADS);
+    free(offsets);
+    if (status != AEC_OK) {
+        printf("Parallel decode failed.\n");
+        return 99;
+    }
+
+    if (memcmp(state->ubuf, state->obuf, state->ibuf_len)) {
+        printf("\n%s: Parallel decoder output differs from input.\n",
+               CHECK_FAIL);
+        return 99;
+    }
+    return 0;
+}
+
+static int check_bad_config(struct test_state *state)
+{
+    /* Invalid parameters are rejected before any chunk is coded. */
+    int status;
+    size_t offsets[2] = {0, 0};
+    unsigned int bps = state->strm->bits_per_sample;
+    struct aec_stream *strm = state->strm;
+
+    strm->bits_per_sample = 33;
+    strm->next_in = state->ubuf;
+    strm->avail_in = state->ibuf_len;
+    strm->next_out = state->cbuf;
+    strm->avail_out = state->cbuf_len;
+    status = aec_buffer_encode_mt(strm, NTHREADS);
+    strm->bits_per_sample = bps;
+    if (status != AEC_CONF_ERROR) {
+        printf("\n%s: Parallel encode accepted invalid parameters.\n",
+               CHECK_FAIL);
+        return 99;
+    }
+
+    strm->bits_per_sample = 33;
+    strm->next_in = state->cbuf;
+    strm->avail_in = state->cbuf_len;
+    strm->next_out = state->obuf;
+    strm->avail_out = state->cbuf_len;
+    status = aec_buffer_decode_mt(strm, offsets, 2, NTHREADS);
+    strm->bits_per_sample = bps;
+    if (status != AEC_CONF_ERROR) {
+        printf("\n%s: Parallel decode accepted invalid parameters.\n",
+               CHECK_FAIL);
+        return 99;
+    }
+    return 0;
+}
+
+static int check_rsi_lengths(struct test_state *state)
+{
+    int status;
+    unsigned int rsi;
+    size_t short_len;
+
+    status = check_bad_config(state);
+    if (status)
+        return status;
+
+    for (rsi = 1; rsi <= 4096; rsi *= 8) {
+        state->strm->rsi = rsi;
+        state->ibuf_len = state->buf_len;
+        status = check_mt(state);
+        if (status)
+            return status;
+        status = check_mt_decode(state);
+        if (status)
+            return status;
+
+        /* last RSI incomplete */
+        short_len = state->buf_len
+            - (rsi * state->strm->block_size / 2 + 1)
+            * state->bytes_per_sample;
+        state->ibuf_len = short_len;
+        status = check_mt(state);
+        if (status)
+            return status;
+        status = check_mt_decode(state);
+        if (status)
+            return status;
+    }
+    state->ibuf_len = state->buf_len;
+    return 0;
+}
+
+int main(void)
+{
+    int status, bps, bs;
+    unsigned int flags[] = {
+        AEC_DATA_PREPROCESS,
+        AEC_PAD_RSI,
+        AEC_PAD_RSI | AEC_DATA_PREPROCESS,
+        AEC_PAD_RSI | AEC_DATA_PREPROCESS | AEC_DATA_SIGNED,
+        AEC_PAD_RSI | AEC_DATA_PREPROCESS | AEC_DATA_MSB
+    };
+    size_t i;
+    struct aec_stream strm;
+    struct test_state state;
+
+    state.buf_len = state.ibuf_len = BUF_SIZE;
+    state.cbuf_len = 2 * BUF_SIZE;
+
+    state.ubuf = (unsigned char *)malloc(state.buf_len);
+    state.cbuf = (unsigned char *)malloc(state.cbuf_len);
+    state.obuf = (unsigned char *)malloc(state.cbuf_len);
+
+    if (!state.ubuf || !state.cbuf || !state.obuf) {
+        printf("Not enough memory.\n");
+        return 99;
+    }
+
+    state.strm = &strm;
+    status = 0;
+
+    for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        for (bps = 8; bps <= 32; bps += 8) {
+            strm.bits_per_sample = bps;
+            strm.flags = flags[i];
+            if (bps == 24)
+                strm.flags |= AEC_DATA_3BYTE;
+            update_state(&state);
+            fill_random_walk(&state, 42, 3, 4096);
+
+            printf("Checking parallel coding with %2i bit, flags %3u ... ",
+                   bps, strm.flags);
+            for (bs = 8; bs <= 64; bs *= 2) {
+                strm.block_size = bs;
+                status = check_rsi_lengths(&state);
+                if (status)
+                    goto DESTRUCT;
+            }
+            printf("%s\n", CHECK_PASS);
+        }
+    }
+
+DESTRUCT:
+    free(state.ubuf);
+    free(state.cbuf);
+    free(state.obuf);
+
+    return status;
+}
@@ -0,0 +1,268 @@
+/**
+ * @file check_pool.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Concurrent coding with a shared thread pool
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "check_aec.h"
+
+#define BUF_SIZE (1024 * 1024)
+#define NWORKERS 3
+#define NCALLERS 4
+#define NROUNDS 8
+#define NBUFFERS 29
+
+struct shared {
+    struct aec_stream strm;
+    struct aec_pool *pool;
+
+    /* uncompressed and reference compressed data */
+    unsigned char *ubuf;
+    unsigned char *cbuf;
+    size_t len;
+    size_t clen;
+
+    size_t *offsets;
+    size_t noffsets;
+};
+
+struct caller {
+    struct shared *shared;
+    int id;
+    int status;
+};
+
+static void fill_buffer(unsigned char *buf, size_t len)
+{
+    size_t i;
+    int x = 30000;
+
+    srand(23);
+    for (i = 0; i < len; i += 2) {
+        /* Noisy stretches make some chunks much slower than others */
+        if ((i / 16384) % 7 == 0)
+            x = rand() & 0xffff;
+        else
+            x = (x + rand() % 17 - 8) & 0xffff;
+        buf[i] = x & 0xff;
+        buf[i + 1] = x >> 8;
+    }
+}
+
+static int code_pool(struct shared *shared, unsigned char *cbuf,
+                     unsigned char *obuf)
+{
+    struct aec_stream strm = shared->strm;
+
+    strm.next_in = shared->ubuf;
+    strm.avail_in = shared->len;
+    strm.next_out = cbuf;
+    strm.avail_out = 2 * shared->len;
+    if (aec_buffer_encode_pool(&strm, shared->pool) != AEC_OK
+        || strm.total_out != shared->clen
+        || memcmp(cbuf, shared->cbuf, shared->clen))
+        return 1;
+
+    strm.next_in = cbuf;
+    strm.avail_in = shared->clen;
+    strm.next_out = obuf;
+    strm.avail_out = shared->len;
+    if (aec_buffer_decode_pool(&strm, shared->offsets, shared->noffsets,
+                               shared->pool) != AEC_OK
+        || strm.total_out != shared->len
+        || memcmp(obuf, shared->ubuf, shared->len))
+        return 2;
+    return 0;
+}
+
+static int code_batch_pool(struct shared *shared, unsigned char *cbuf,
+                           unsigned char *obuf)
+{
+    struct aec_stream strm = shared->strm;
+    struct aec_buffer enc[NBUFFERS], dec[NBUFFERS];
+    size_t n, pos, len, room;
+
+    /* Buffers of very different sizes */
+    room = 2 * shared->len / NBUFFERS;
+    pos = 0;
+    for (n = 0; n < NBUFFERS; n++) {
+        len = shared->len / NBUFFERS / (n % 3 + 1);
+        len -= len % 2;
+        enc[n].next_in = shared->ubuf + pos;
+        enc[n].avail_in = len;
+        enc[n].next_out = cbuf + n * room;
+        enc[n].avail_out = room;
+        dec[n].next_out = obuf + pos;
+        dec[n].avail_out = len;
+        pos += len;
+    }
+    if (aec_buffer_encode_batch_pool(&strm, enc, NBUFFERS,
+                                     shared->pool) != AEC_OK)
+        return 3;
+
+    for (n = 0; n < NBUFFERS; n++) {
+        dec[n].next_in = enc[n].next_out;
+        dec[n].avail_in = enc[n].total_out;
+    }
+    if (aec_buffer_decode_batch_pool(&strm, dec, NBUFFERS,
+                                     shared->pool) != AEC_OK
+        || memcmp(obuf, shared->ubuf, pos))
+        return 4;
+    return 0;
+}
+
+static void *run_caller(void *arg)
+{
+    struct caller *caller = arg;
+    unsigned char *cbuf, *obuf;
+    int i;
+
+    cbuf = malloc(2 * caller->shared->len);
+    obuf = malloc(caller->shared->len);
+    caller->status = 99;
+    if (cbuf == NULL || obuf == NULL)
+        goto EXIT;
+
+    caller->status = 0;
+    for (i = 0; i < NROUNDS && caller->status == 0; i++) {
+        if ((i + caller->id) & 1)
+            caller->status = code_pool(caller->shared, cbuf, obuf);
+        else
+            caller->status = code_batch_pool(caller->shared, cbuf, obuf);
+    }
+
+EXIT:
+    free(cbuf);
+    free(obuf);
+    return NULL;
+}
+
+int main(void)
+{
+    int i, status;
+    struct shared shared;
+    struct aec_stream *strm = &shared.strm;
+    struct caller callers[NCALLERS];
+    pthread_t threads[NCALLERS];
+
+    memset(&shared, 0, sizeof(shared));
+    strm->bits_per_sample = 16;
+    strm->block_size = 16;
+    strm->rsi = 64;
+    strm->flags = AEC_DATA_PREPROCESS | AEC_PAD_RSI;
+
+    shared.len = BUF_SIZE;
+    shared.ubuf = malloc(shared.len);
+    shared.cbuf = malloc(2 * shared.len);
+    if (shared.ubuf == NULL || shared.cbuf == NULL) {
+        printf("Not enough memory.\n");
+        return 99;
+    }
+    fill_buffer(shared.ubuf, shared.len);
+
+    strm->next_in = shared.ubuf;
+    strm->avail_in = shared.len;
+    strm->next_out = shared.cbuf;
+    strm->avail_out = 2 * shared.len;
+    if (aec_encode_init(strm) != AEC_OK
+        || aec_encode_enable_offsets(strm) != AEC_OK
+        || aec_encode(strm, AEC_FLUSH) != AEC_OK
+        || aec_encode_count_offsets(strm, &shared.noffsets) != AEC_OK) {
+        printf("Encode failed.\n");
+        return 99;
+    }
+    shared.clen = strm->total_out;
+    shared.offsets = malloc(shared.noffsets * sizeof(size_t));
+    if (shared.offsets == NULL) {
+        printf("Not enough memory.\n");
+        return 99;
+    }
+    aec_encode_get_offsets(strm, shared.offsets, shared.noffsets);
+    aec_encode_end(strm);
+
+    shared.pool = aec_pool_create(NWORKERS);
+    if (shared.pool == NULL) {
+        printf("Creating thread pool failed.\n");
+        return 99;
+    }
+
+    printf("Checking %i concurrent callers of a pool with %i workers ... ",
+           NCALLERS, NWORKERS);
+    fflush(stdout);
+
+    for (i = 0; i < NCALLERS; i++) {
+        callers[i].shared = &shared;
+        callers[i].id = i;
+        if (pthread_create(&threads[i], NULL, run_caller, &callers[i])) {
+            printf("Starting thread failed.\n");
+            return 99;
+        }
+    }
+
+    status = 0;
+    for (i = 0; i < NCALLERS; i++) {
+        pthread_join(threads[i], NULL);
+        if (callers[i].status && status == 0)
+            status = callers[i].status;
+    }
+    aec_pool_destroy(shared.pool);
+
+    if (status) {
+        printf("\n%s: Coding with pool failed (%i).\n", CHECK_FAIL, status);
+        status = 99;
+    } else {
+        printf("%s\n", CHECK_PASS);
+    }
+
+    free(shared.offsets);
+    free(shared.ubuf);
+    free(shared.cbuf);
+    return status;
+}
@@ -0,0 +1,292 @@
+/**
+ * @file check_reset.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Reuse of encoder and decoder states
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check_aec.h"
+
+#define BUF_SIZE (64 * 1024)
+#define NCHUNKS 4
+
+static size_t chunk_len(struct test_state *state, int n)
+{
+    /* Chunks of different length, not all of them whole RSIs */
+    size_t len = state->buf_len / NCHUNKS;
+
+    len -= (n * 37) * state->bytes_per_sample;
+    return len - len % state->bytes_per_sample;
+}
+
+static int check_bad_reset(struct aec_stream *enc, struct aec_stream *dec)
+{
+    /**
+       A reset with invalid parameters has to fail and keep the
+       streams usable.
+    */
+
+    int status;
+    unsigned int bs = enc->block_size;
+    unsigned int bps = dec->bits_per_sample;
+
+    enc->block_size = 7;
+    status = aec_buffer_encode_ctx(enc);
+    enc->block_size = bs;
+    if (status != AEC_CONF_ERROR) {
+        printf("\n%s: Invalid block size accepted by reset (%i).\n",
+               CHECK_FAIL, status);
+        return 99;
+    }
+
+    dec->bits_per_sample = 33;
+    status = aec_buffer_decode_ctx(dec);
+    dec->bits_per_sample = bps;
+    if (status != AEC_CONF_ERROR) {
+        printf("\n%s: Invalid sample size accepted by reset (%i).\n",
+               CHECK_FAIL, status);
+        return 99;
+    }
+    return 0;
+}
+
+static int check_chunks(struct test_state *state, struct aec_stream *enc,
+                        struct aec_stream *dec)
+{
+    int n, status;
+    unsigned int bs;
+    size_t len, clen;
+    unsigned char *in;
+    struct aec_stream *strm = state->strm;
+
+    bs = strm->block_size;
+    in = state->ubuf;
+    for (n = 0; n < NCHUNKS; n++) {
+        if (n == 1 && (status = check_bad_reset(enc, dec)))
+            return status;
+        len = chunk_len(state, n);
+        /* Switch block size for one chunk to force a new setup */
+        strm->block_size = n == 2 ? 8 : bs;
+        enc->block_size = strm->block_size;
+        dec->block_size = strm->block_size;
+
+        strm->next_in = in;
+        strm->avail_in = len;
+        strm->next_out = state->cbuf;
+        strm->avail_out = state->cbuf_len;
+        status = aec_buffer_encode(strm);
+        if (status != AEC_OK) {
+            printf("Encode failed.\n");
+            return 99;
+        }
+        clen = strm->total_out;
+        strm->block_size = bs;
+
+        enc->next_in = in;
+        enc->avail_in = len;
+        enc->next_out = state->obuf;
+        enc->avail_out = state->cbuf_len;
+        status = aec_buffer_encode_ctx(enc);
+        if (status != AEC_OK) {
+            printf("Encode with context failed (%i).\n", status);
+            return 99;
+        }
+        if (enc->total_out != clen
+            || memcmp(state->cbuf, state->obuf, clen)) {
+            printf("\n%s: Output of reused encoder differs in chunk %i.\n",
+                   CHECK_FAIL, n);
+            return 99;
+        }
+
+        dec->next_in = state->cbuf;
+        dec->avail_in = clen;
+        dec->next_out = state->obuf;
+        dec->avail_out = len;
+        status = aec_buffer_decode_ctx(dec);
+        if (status != AEC_OK) {
+            printf("Decode with context failed (%i).\n", status);
+            return 99;
+        }
+        if (dec->total_out != len || memcmp(in, state->obuf, len)) {
+            printf("\n%s: Output of reused decoder differs in chunk %i.\n",
+                   CHECK_FAIL, n);
+            return 99;
+        }
+        in += len;
+    }
+    return 0;
+}
+
+static int check_reset(struct test_state *state)
+{
+    int status;
+    size_t len, clen;
+    struct aec_stream *strm = state->strm;
+    struct aec_stream enc, dec;
+
+    len = chunk_len(state, 0);
+    strm->next_in = state->ubuf;
+    strm->avail_in = len;
+    strm->next_out = state->cbuf;
+    strm->avail_out = state->cbuf_len;
+    if (aec_buffer_encode(strm) != AEC_OK) {
+        printf("Encode failed.\n");
+        return 99;
+    }
+    clen = strm->total_out;
+
+    /* Abandon a partly coded stream and start over */
+    enc = *strm;
+    enc.next_in = state->ubuf + len / 2;
+    enc.avail_in = len / 2;
+    enc.next_out = state->obuf;
+    enc.avail_out = state->cbuf_len;
+    if (aec_encode_init(&enc) != AEC_OK
+        || aec_encode(&enc, AEC_NO_FLUSH) != AEC_OK
+        || aec_encode_reset(&enc) != AEC_OK) {
+        printf("Reset of encoder failed.\n");
+        return 99;
+    }
+    enc.next_in = state->ubuf;
+    enc.avail_in = len;
+    enc.next_out = state->obuf;
+    enc.avail_out = state->cbuf_len;
+    if (aec_encode(&enc, AEC_FLUSH) != AEC_OK) {
+        printf("Encode failed.\n");
+        return 99;
+    }
+    if (enc.total_out != clen || memcmp(state->cbuf, state->obuf, clen)) {
+        printf("\n%s: Output after reset differs.\n", CHECK_FAIL);
+        return 99;
+    }
+
+    dec = *strm;
+    dec.next_in = state->cbuf;
+    dec.avail_in = clen / 2;
+    dec.next_out = state->obuf;
+    dec.avail_out = len;
+    if (aec_decode_init(&dec) != AEC_OK
+        || aec_decode(&dec, AEC_NO_FLUSH) != AEC_OK
+        || aec_decode_reset(&dec) != AEC_OK) {
+        printf("Reset of decoder failed.\n");
+        return 99;
+    }
+    dec.next_in = state->cbuf;
+    dec.avail_in = clen;
+    dec.next_out = state->obuf;
+    dec.avail_out = len;
+    if (aec_decode(&dec, AEC_FLUSH) != AEC_OK) {
+        printf("Decode failed.\n");
+        return 99;
+    }
+    if (dec.total_out != len || memcmp(state->ubuf, state->obuf, len)) {
+        printf("\n%s: Decoded output after reset differs.\n", CHECK_FAIL);
+        return 99;
+    }
+
+    status = check_chunks(state, &enc, &dec);
+    aec_encode_end(&enc);
+    aec_decode_end(&dec);
+    return status;
+}
+
+int main(void)
+{
+    int status, bps;
+    unsigned int flags[] = {
+        0,
+        AEC_DATA_PREPROCESS,
+        AEC_DATA_PREPROCESS | AEC_DATA_SIGNED,
+        AEC_DATA_PREPROCESS | AEC_DATA_MSB | AEC_PAD_RSI
+    };
+    size_t i;
+    struct aec_stream strm;
+    struct test_state state;
+
+    state.buf_len = state.ibuf_len = BUF_SIZE;
+    state.cbuf_len = 2 * BUF_SIZE;
+
+    state.ubuf = (unsigned char *)malloc(state.buf_len);
+    state.cbuf = (unsigned char *)malloc(state.cbuf_len);
+    state.obuf = (unsigned char *)malloc(state.cbuf_len);
+
+    if (!state.ubuf || !state.cbuf || !state.obuf) {
+        printf("Not enough memory.\n");
+        return 99;
+    }
+
+    state.strm = &strm;
+    status = 0;
+
+    for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        for (bps = 8; bps <= 32; bps += 8) {
+            strm.bits_per_sample = bps;
+            strm.block_size = 16;
+            strm.rsi = 32;
+            strm.flags = flags[i];
+            if (bps == 24)
+                strm.flags |= AEC_DATA_3BYTE;
+            update_state(&state);
+            fill_random_walk(&state, 7, 32, 1024);
+
+            printf("Checking reuse of states with %2i bit, flags %3u ... ",
+                   bps, strm.flags);
+            status = check_reset(&state);
+            if (status)
+                goto DESTRUCT;
+            printf("%s\n", CHECK_PASS);
+        }
+    }
+
+DESTRUCT:
+    free(state.ubuf);
+    free(state.cbuf);
+    free(state.obuf);
+
+    return status;
+}
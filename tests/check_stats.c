@@ -0,0 +1,311 @@
+/**
+ * @file check_stats.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Check code option statistics of encoder and decoder
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check_aec.h"
+#include "datagen.h"
+
+/* Multiple of all sample sizes */
+#define BUF_SIZE (96 * 1024)
+
+static unsigned char ubuf[BUF_SIZE];
+static unsigned char cbuf[2 * BUF_SIZE];
+static unsigned char obuf[BUF_SIZE];
+
+static size_t sum_blocks(const struct aec_stats *stats)
+{
+    int k;
+    size_t n = stats->se_blocks + stats->zero_blocks + stats->uncomp_blocks;
+
+    for (k = 0; k < AEC_STATS_KMAX; k++)
+        n += stats->split_blocks[k];
+    return n;
+}
+
+static size_t sum_bits(const struct aec_stats *stats)
+{
+    int k;
+    size_t n = stats->se_bits + stats->zero_bits + stats->uncomp_bits;
+
+    for (k = 0; k < AEC_STATS_KMAX; k++)
+        n += stats->split_bits[k];
+    return n;
+}
+
+static int encode(struct datagen *gen, size_t len, size_t *clen,
+                  struct aec_stats *stats)
+{
+    int status;
+    struct aec_stream strm;
+
+    strm.bits_per_sample = gen->bits_per_sample;
+    strm.block_size = gen->block_size;
+    strm.rsi = gen->rsi;
+    strm.flags = gen->flags;
+    strm.next_in = ubuf;
+    strm.avail_in = len;
+    strm.next_out = cbuf;
+    strm.avail_out = sizeof(cbuf);
+
+    if ((status = aec_encode_init(&strm)) != AEC_OK
+        || (status = aec_encode_enable_stats(&strm)) != AEC_OK
+        || (status = aec_encode(&strm, AEC_FLUSH)) != AEC_OK
+        || (status = aec_encode_get_stats(&strm, stats)) != AEC_OK) {
+        printf("Encoding failed (%i).\n", status);
+        return 99;
+    }
+    *clen = strm.total_out;
+
+    /* A reset starts counting from scratch */
+    if ((status = aec_encode_reset(&strm)) != AEC_OK
+        || (status = aec_encode_get_stats(&strm, stats + 1)) != AEC_OK
+        || sum_blocks(stats + 1) != 0) {
+        printf("\n%s: Statistics not cleared by reset (%i).\n",
+               CHECK_FAIL, status);
+        return 1;
+    }
+    aec_encode_end(&strm);
+    return 0;
+}
+
+static int decode(struct datagen *gen, size_t clen, size_t len,
+                  int bytewise, struct aec_stats *stats)
+{
+    /**
+       Decode all at once or one byte of input and one sample of
+       output at a time.
+    */
+
+    int status;
+    size_t in_chunk, out_chunk, total_in, total_out;
+    struct aec_stream strm;
+
+    strm.bits_per_sample = gen->bits_per_sample;
+    strm.block_size = gen->block_size;
+    strm.rsi = gen->rsi;
+    strm.flags = gen->flags;
+    strm.next_in = cbuf;
+    strm.avail_in = 0;
+    strm.next_out = obuf;
+    strm.avail_out = 0;
+
+    if ((status = aec_decode_init(&strm)) != AEC_OK
+        || (status = aec_decode_enable_stats(&strm)) != AEC_OK) {
+        printf("Decoding failed (%i).\n", status);
+        return 99;
+    }
+
+    in_chunk = bytewise? 1: clen;
+    out_chunk = bytewise? (size_t)datagen_sample_size(gen): len;
+    do {
+        if (strm.avail_in == 0 && strm.total_in < clen)
+            strm.avail_in = in_chunk;
+        if (strm.avail_out == 0)
+            strm.avail_out = out_chunk;
+        total_in = strm.total_in;
+        total_out = strm.total_out;
+        if ((status = aec_decode(&strm, AEC_FLUSH)) != AEC_OK) {
+            printf("Decoding failed (%i).\n", status);
+            return 99;
+        }
+    } while (strm.total_out < len
+             && (strm.total_in > total_in || strm.total_out > total_out));
+
+    if ((status = aec_decode_get_stats(&strm, stats)) != AEC_OK) {
+        printf("Decoding failed (%i).\n", status);
+        return 99;
+    }
+    aec_decode_end(&strm);
+
+    if (strm.total_out != len || memcmp(ubuf, obuf, len)) {
+        printf("\n%s: Round trip failed.\n", CHECK_FAIL);
+        return 1;
+    }
+    return 0;
+}
+
+static int check(struct datagen *gen)
+{
+    /**
+       Encoder and decoder statistics have to agree and cover all
+       blocks and coded bits.
+    */
+
+    int status, i;
+    size_t len, clen, n, blocks, bits;
+    struct aec_stats enc[2], dec;
+
+    len = datagen_fill(gen, ubuf, BUF_SIZE);
+    if ((status = encode(gen, len, &clen, enc)))
+        return status;
+
+    blocks = (len / datagen_sample_size(gen) + gen->block_size - 1)
+        / gen->block_size;
+    if (sum_blocks(enc) != blocks) {
+        printf("\n%s: %lu blocks counted, %lu expected.\n",
+               CHECK_FAIL, (unsigned long)sum_blocks(enc),
+               (unsigned long)blocks);
+        return 1;
+    }
+
+    /* Only fill bits at the end of RSIs or the stream are not
+     * counted */
+    bits = sum_bits(enc);
+    if (bits > clen * 8
+        || ((gen->flags & AEC_PAD_RSI) == 0 && bits + 8 <= clen * 8)) {
+        printf("\n%s: %lu bits counted, %lu coded.\n",
+               CHECK_FAIL, (unsigned long)bits,
+               (unsigned long)clen * 8);
+        return 1;
+    }
+
+    blocks = 0;
+    for (n = 0; n < AEC_STATS_RUNS; n++)
+        blocks += n * enc->zero_runs[n];
+    if (blocks != enc->zero_blocks) {
+        printf("\n%s: Zero block runs do not add up.\n", CHECK_FAIL);
+        return 1;
+    }
+
+    for (i = 0; i < 2; i++) {
+        if ((status = decode(gen, clen, len, i, &dec)))
+            return status;
+        if (memcmp(enc, &dec, sizeof(dec))) {
+            printf("\n%s: Decoder statistics differ from encoder.\n",
+                   CHECK_FAIL);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int check_zero_blocks(struct datagen *gen)
+{
+    int status;
+    size_t len, clen, blocks;
+    struct aec_stats stats[2];
+
+    gen->model = DATAGEN_OPTIONS;
+    gen->options = DATAGEN_ZERO_BLOCK;
+    gen->zero_run = 64;
+    len = datagen_fill(gen, ubuf, BUF_SIZE);
+    if ((status = encode(gen, len, &clen, stats)))
+        return status;
+
+    blocks = len / datagen_sample_size(gen) / gen->block_size;
+    if (stats->zero_blocks != blocks) {
+        printf("\n%s: %lu of %lu blocks are zero blocks.\n",
+               CHECK_FAIL, (unsigned long)stats->zero_blocks,
+               (unsigned long)blocks);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    int status, i, j;
+    unsigned int bps[] = {1, 8, 12, 16, 17, 24, 32};
+    unsigned int flags[] = {
+        AEC_DATA_PREPROCESS,
+        AEC_DATA_PREPROCESS | AEC_DATA_SIGNED | AEC_DATA_MSB,
+        AEC_DATA_PREPROCESS | AEC_PAD_RSI,
+        AEC_DATA_PREPROCESS | AEC_RESTRICTED,
+        0
+    };
+    struct datagen gen;
+    struct aec_stream strm;
+    struct aec_stats stats;
+
+    for (i = 0; i < (int)(sizeof(flags) / sizeof(flags[0])); i++) {
+        for (j = 0; j < (int)(sizeof(bps) / sizeof(bps[0])); j++) {
+            if (flags[i] & AEC_RESTRICTED && bps[j] > 4)
+                continue;
+            printf("Checking statistics for %2u bit, flags %2u ... ",
+                   bps[j], flags[i]);
+            datagen_init(&gen, bps[j], 16, 64, flags[i]);
+            gen.model = DATAGEN_OPTIONS;
+            gen.zero_run = 6;
+            if ((status = check(&gen)))
+                return status;
+            gen.model = DATAGEN_SMOOTH;
+            if ((status = check(&gen)))
+                return status;
+            if (bps[j] >= 8 && (status = check_zero_blocks(&gen)))
+                return status;
+            printf("%s\n", CHECK_PASS);
+        }
+    }
+
+    printf("Checking statistics are off by default ... ");
+    strm.bits_per_sample = 8;
+    strm.block_size = 16;
+    strm.rsi = 64;
+    strm.flags = AEC_DATA_PREPROCESS;
+    if (aec_encode_init(&strm) != AEC_OK)
+        return 99;
+    status = aec_encode_get_stats(&strm, &stats);
+    aec_encode_end(&strm);
+    if (status != AEC_CONF_ERROR) {
+        printf("%s\n", CHECK_FAIL);
+        return 1;
+    }
+    if (aec_decode_init(&strm) != AEC_OK)
+        return 99;
+    status = aec_decode_get_stats(&strm, &stats);
+    aec_decode_end(&strm);
+    if (status != AEC_CONF_ERROR) {
+        printf("%s\n", CHECK_FAIL);
+        return 1;
+    }
+    printf("%s\n", CHECK_PASS);
+    return 0;
+}
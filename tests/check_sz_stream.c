@@ -0,0 +1,274 @@
+/**
+ * @file check_sz_stream.c
+ *
+ * @section LICENSE
+ * Copyright 2012 - 2016
+ *
+ * Mathis Rosenhauer, Moritz Hanke, Joerg Behrens
+ * Deutsches Klimarechenzentrum GmbH
+ * Bundesstr. 45a
+ * 20146 Hamburg Germany
+ *
+ * Luis Kornblueh
+ * Max-Planck-Institut fuer Meteorologie
+ * Bundesstr. 53
+ * 20146 Hamburg
+ * Germany
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @section DESCRIPTION
+ *
+ * Check the streaming SZIP compatibility functions
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check_aec.h"
+#include "szlib.h"
+
+#define IMAGE_PIXELS 5000
+#define MIN(a, b) (((a) < (b))? (a): (b))
+
+static size_t fill_buffer(unsigned char *buf, size_t n, int bpp, int msb)
+{
+    /**
+       Random walk of n pixels in the storage format of the SZIP
+       library. Returns the number of bytes.
+    */
+
+    size_t i;
+    int j, size;
+    unsigned long long x, mask;
+
+    if (bpp > 32)
+        size = 8;
+    else if (bpp > 16)
+        size = 4;
+    else if (bpp > 8)
+        size = 2;
+    else
+        size = 1;
+    mask = bpp == 64? ~0ULL: (1ULL << bpp) - 1;
+    x = mask / 3;
+
+    srand(41);
+    for (i = 0; i < n; i++) {
+        x = (x + (unsigned long long)(rand() % 65) - 32) & mask;
+        for (j = 0; j < size; j++)
+            buf[i * size + j] =
+                (unsigned char)(x >> (8 * (msb? size - 1 - j: j)));
+    }
+    return n * size;
+}
+
+static int stream_compress(sz_stream *strm, unsigned char *dest,
+                           size_t *dest_len, const unsigned char *src,
+                           size_t src_len, size_t chunk)
+{
+    /**
+       Compress with input and output given chunk bytes at a time.
+    */
+
+    int status, flush;
+    size_t in_end, out_end;
+
+    status = SZ_CompressInit(strm);
+    if (status != SZ_OK)
+        return status;
+
+    strm->next_in = src;
+    strm->avail_in = 0;
+    strm->next_out = dest;
+    strm->avail_out = 0;
+    in_end = out_end = 0;
+    do {
+        if (strm->avail_in == 0 && in_end < src_len) {
+            strm->avail_in = MIN(chunk, src_len - in_end);
+            in_end += strm->avail_in;
+        }
+        if (strm->avail_out == 0) {
+            strm->avail_out = MIN(chunk + 1, *dest_len - out_end);
+            out_end += strm->avail_out;
+        }
+        flush = in_end == src_len? SZ_FINISH: SZ_NO_FLUSH;
+        status = SZ_Compress(strm, flush);
+        if (status < 0)
+            return status;
+    } while (status != SZ_STREAM_END && out_end < *dest_len);
+
+    if (status != SZ_STREAM_END)
+        return SZ_OUTBUFF_FULL;
+    *dest_len = strm->total_out;
+    return SZ_CompressEnd(strm);
+}
+
+static int stream_decompress(sz_stream *strm, unsigned char *dest,
+                             size_t dest_len, const unsigned char *src,
+                             size_t src_len, size_t chunk)
+{
+    int status;
+    size_t in_end, out_end;
+
+    status = SZ_DecompressInit(strm);
+    if (status != SZ_OK)
+        return status;
+
+    strm->next_in = src;
+    strm->avail_in = 0;
+    strm->next_out = dest;
+    strm->avail_out = 0;
+    in_end = out_end = 0;
+    do {
+        if (strm->avail_in == 0 && in_end < src_len) {
+            strm->avail_in = MIN(chunk + 2, src_len - in_end);
+            in_end += strm->avail_in;
+        }
+        if (strm->avail_out == 0 && out_end < dest_len) {
+            strm->avail_out = MIN(chunk, dest_len - out_end);
+            out_end += strm->avail_out;
+        }
+        status = SZ_Decompress(strm, SZ_NO_FLUSH);
+        if (status < 0)
+            return status;
+    } while (status != SZ_STREAM_END);
+
+    return SZ_DecompressEnd(strm);
+}
+
+static int check_stream(const unsigned char *src, size_t len,
+                        SZ_com_t *param, size_t chunk)
+{
+    int status;
+    size_t clen, slen, buf_len;
+    unsigned char *ref, *cbuf, *dbuf;
+    sz_stream strm;
+
+    buf_len = 2 * len + 4096;
+    ref = malloc(buf_len);
+    cbuf = malloc(buf_len);
+    dbuf = malloc(len);
+    status = 99;
+    if (!ref || !cbuf || !dbuf) {
+        printf("Not enough memory.\n");
+        goto EXIT;
+    }
+
+    clen = buf_len;
+    if (SZ_BufftoBuffCompress(ref, &clen, src, len, param) != SZ_OK) {
+        printf("Compression failed.\n");
+        goto EXIT;
+    }
+
+    strm.options_mask = param->options_mask;
+    strm.bits_per_pixel = param->bits_per_pixel;
+    strm.pixels_per_block = param->pixels_per_block;
+    strm.pixels_per_scanline = param->pixels_per_scanline;
+    strm.image_pixels = IMAGE_PIXELS;
+
+    slen = buf_len;
+    if (stream_compress(&strm, cbuf, &slen, src, len, chunk) != SZ_OK) {
+        printf("Stream compression failed.\n");
+        goto EXIT;
+    }
+    if (slen != clen || memcmp(cbuf, ref, clen)) {
+        printf("\n%s: Stream compression with chunks of %lu differs.\n",
+               CHECK_FAIL, (unsigned long)chunk);
+        status = 1;
+        goto EXIT;
+    }
+
+    memset(dbuf, 0, len);
+    if (stream_decompress(&strm, dbuf, len, cbuf, clen, chunk) != SZ_OK) {
+        printf("Stream decompression failed.\n");
+        goto EXIT;
+    }
+    if (strm.total_out != len || memcmp(dbuf, src, len)) {
+        printf("\n%s: Stream decompression with chunks of %lu differs.\n",
+               CHECK_FAIL, (unsigned long)chunk);
+        status = 1;
+        goto EXIT;
+    }
+    status = 0;
+
+EXIT:
+    free(ref);
+    free(cbuf);
+    free(dbuf);
+    return status;
+}
+
+int main(void)
+{
+    int status;
+    size_t i, j, k, m, len;
+    int options[] = {
+        SZ_NN_OPTION_MASK | SZ_MSB_OPTION_MASK,
+        SZ_LSB_OPTION_MASK
+    };
+    int bpps[] = {8, 12, 16, 24, 32, 64};
+    int scanlines[] = {256, 100, 7};
+    size_t chunks[] = {1, 13, 1000, 100000};
+    unsigned char *src;
+    SZ_com_t param;
+
+    src = malloc(IMAGE_PIXELS * 8);
+    if (!src) {
+        printf("Not enough memory.\n");
+        return 99;
+    }
+
+    status = 0;
+    param.pixels_per_block = 16;
+
+    for (m = 0; m < sizeof(options) / sizeof(options[0]); m++) {
+        param.options_mask = options[m];
+        for (i = 0; i < sizeof(bpps) / sizeof(bpps[0]); i++) {
+            param.bits_per_pixel = bpps[i];
+            len = fill_buffer(src, IMAGE_PIXELS, bpps[i],
+                              options[m] & SZ_MSB_OPTION_MASK);
+            for (j = 0; j < sizeof(scanlines) / sizeof(scanlines[0]); j++) {
+                param.pixels_per_scanline = scanlines[j];
+                printf("Checking stream with %2i bit, options %2i, "
+                       "scanline %3i ... ",
+                       bpps[i], options[m], scanlines[j]);
+                for (k = 0; k < sizeof(chunks) / sizeof(chunks[0]); k++) {
+                    status = check_stream(src, len, &param, chunks[k]);
+                    if (status)
+                        goto DESTRUCT;
+                }
+                printf("%s\n", CHECK_PASS);
+            }
+        }
+    }
+
+DESTRUCT:
+    free(src);
+    return status;
+}